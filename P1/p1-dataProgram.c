@@ -15,6 +15,7 @@
 #include <errno.h>
 
 #include "./helpers/indexador.h"
+#include "./helpers/csv.h"
 
 #define PIPE_REQ "./output/search_req.pipe"
 #define PIPE_RES "./output/search_res.pipe"
@@ -167,63 +168,37 @@ Song readSongAt(FILE *file, long pos) {
         return song;
     }
 
-    // Misma lógica de buildIndex para el parseo
-    char *p_line = line;
-    char *tokens[NUM_FIELDS] = {0};
-    for (int i = 0; i < NUM_FIELDS; i++) {
-        char *start = p_line;
+    // Mismo tokenizador que usa el indexador (helpers/csv.h)
+    CsvSpan tokens[NUM_FIELDS];
+    csv_split_fields(line, line + strcspn(line, "\r\n"), tokens, NUM_FIELDS);
 
-        while (*p_line && *p_line != ','){
-            if(*p_line == '['){
-                while (*p_line && *p_line != ']') p_line++;
-            }
-            if (*p_line) p_line++;
-        }
-        
-        if (*p_line) {
-            *p_line = '\0';
-            p_line++;
-        }
-        tokens[i] = start;
-    }
-    
     // Asignar los campos a la estructura Song
-    if (tokens[0]) snprintf(song.lastfm_url, sizeof(song.lastfm_url), "%s", tokens[0]);
-    if (tokens[1]) snprintf(song.track, sizeof(song.track), "%s", tokens[1]);
-    if (tokens[2]) snprintf(song.artist, sizeof(song.artist), "%s", tokens[2]);
-
-    if (tokens[3]) {
-        char *p_seeds = tokens[3];
-        while ((p_seeds = strchr(p_seeds, '\'')) != NULL && song.seed_count < MAX_SEEDS) {
-            p_seeds++; // Mover el puntero más allá de la comilla de apertura
-            char *end_quote = strchr(p_seeds, '\'');
-            if (!end_quote) break; // Si no hay comilla de cierre, la línea está mal formada
-
-            // Guardamos el carácter original y ponemos un terminador nulo para copiar
-            char original_char = *end_quote;
-            *end_quote = '\0';
-
-            // Copiamos la emoción encontrada
-            snprintf(song.seeds[song.seed_count++], MAX_FIELD, "%s", p_seeds);
-            
-            // Restauramos el carácter original para no alterar el resto del parseo
-            *end_quote = original_char;
-
-            // Avanzamos el puntero para la siguiente búsqueda
-            p_seeds = end_quote + 1;
-        }
+    csv_span_copy(song.lastfm_url, sizeof(song.lastfm_url), &tokens[0]);
+    csv_span_copy(song.track, sizeof(song.track), &tokens[1]);
+    csv_span_copy(song.artist, sizeof(song.artist), &tokens[2]);
+
+    // Cada emoción del campo seeds va entre comillas simples
+    const char *p_seeds = tokens[3].start;
+    const char *seeds_end = tokens[3].start + tokens[3].len;
+    while (song.seed_count < MAX_SEEDS && (p_seeds = memchr(p_seeds, '\'', seeds_end - p_seeds)) != NULL) {
+        p_seeds++; // Mover el puntero más allá de la comilla de apertura
+        const char *end_quote = memchr(p_seeds, '\'', seeds_end - p_seeds);
+        if (!end_quote) break; // Si no hay comilla de cierre, la línea está mal formada
+
+        CsvSpan seed = { p_seeds, (size_t)(end_quote - p_seeds) };
+        csv_span_copy(song.seeds[song.seed_count++], MAX_FIELD, &seed);
+
+        // Avanzamos el puntero para la siguiente búsqueda
+        p_seeds = end_quote + 1;
     }
 
-    if (tokens[4]) song.number_of_emotions = atof(tokens[4]);
-    if (tokens[5]) song.valence_tags = atof(tokens[5]);
-    if (tokens[6]) song.arousal_tags = atof(tokens[6]);
-    if (tokens[7]) song.dominance_tags = atof(tokens[7]);
-    
-    // El token de género es el último, puede contener el salto de línea
-    if (tokens[11]) {
-        snprintf(song.genre, sizeof(song.genre), "%s", tokens[11]);
-        song.genre[strcspn(song.genre, "\r\n")] = 0;
-    }
+    song.number_of_emotions = csv_span_atof(&tokens[4]);
+    song.valence_tags = csv_span_atof(&tokens[5]);
+    song.arousal_tags = csv_span_atof(&tokens[6]);
+    song.dominance_tags = csv_span_atof(&tokens[7]);
+
+    // El género es el último campo; el salto de línea ya quedó fuera del tramo
+    csv_span_copy(song.genre, sizeof(song.genre), &tokens[11]);
 
     return song;
 }
@@ -7,15 +7,25 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <ctype.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <time.h>
 
 #include "./helpers/indexador.h"
+#include "./helpers/protocol.h"
 
 #define PORT 3550
 #define HOST "34.44.216.84" // "127.0.0.1" // Cambiar a la IP del servidor si es necesario
 // ¡OJO! En cada deploy el EXTERNAL_IP puede cambiar
+#define HELLO_TIMEOUT_S 3 // Sin respuesta al saludo se asume un servidor v1
+#define BATCH_WINDOW 16 // Búsquedas en vuelo en modo --batch (v3)
+#define PAGE_SIZE 10 // Canciones por página en el menú (v3)
 
 int clientfd = -1;
+int protocol = 1; // Versión acordada con el servidor
+uint32_t next_request_id = 0; // Id de la última búsqueda interactiva
 
 // Manejador de Ctrl+C
 void handle_sigint(int sig) {
@@ -39,30 +49,46 @@ void printSong(Song s) {
     printf("🔗 URL: %s\n", s.lastfm_url);
 }
 
-void mostrarMenuPrincipal() {
-    printf("\n\n====================\n");
-    printf("🌟 Menú Principal:\n");
-    printf("1. Ingresar emoción ❤️ \n");
-    printf("2. Ingresar la intensidad (0-100) 🎚️\n");
-    printf("3. Ingresar el artista 🎤\n");
-    printf("4. Realizar la búsqueda 🔍\n");
-    printf("9. Salir\n");
-    printf("Seleccione una opción: ");
+// send/recv completos: el socket puede entregar o aceptar menos bytes de los pedidos
+static int send_all(const void *data, size_t size) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t n = send(clientfd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int recv_all(void *data, size_t size) {
+    char *p = data;
+    while (size > 0) {
+        ssize_t n = recv(clientfd, p, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
 }
 
+// Recibe un mensaje completo en `buf` (PROTO_MAX_HEADER_BYTES + PROTO_MAX_PAYLOAD bytes)
+static int recv_message(ProtoFrame *frame, uint8_t *buf) {
+    size_t header = proto_header_bytes(protocol);
+    if (recv_all(buf, header) != 0 || proto_read_header(buf, protocol, frame) != 0) return -1;
+    return recv_all(buf + header, frame->len);
+}
 
-int main() {
+static int connect_server(void) {
     struct sockaddr_in server;
-    signal(SIGINT, handle_sigint);
-
-    // 1. Crear Socket
     clientfd = socket(AF_INET, SOCK_STREAM, 0);
     if (clientfd == -1) {
         perror("❌ Error creando socket");
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
-    // 2. Conectar al servidor
     server.sin_family = AF_INET;
     server.sin_port = htons(PORT);
     server.sin_addr.s_addr = inet_addr(HOST);
@@ -70,10 +96,298 @@ int main() {
 
     if (connect(clientfd, (struct sockaddr *)&server, sizeof(server)) == -1) {
         perror("❌ Error conectando al servidor");
-        exit(EXIT_FAILURE);
+        close(clientfd);
+        clientfd = -1;
+        return -1;
+    }
+    // Cada mensaje sale en un solo send: sin Nagle no espera el ACK del anterior
+    int nodelay = 1;
+    setsockopt(clientfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return 0;
+}
+
+// Saluda con la versión más alta que entiende el cliente. Un servidor v1 no responde
+// (espera el resto de una petición), así que al vencer el plazo se reconecta en v1.
+static int negotiate_protocol(void) {
+    uint8_t hello[PROTO_HELLO_BYTES], version = 0;
+    struct timeval timeout = { .tv_sec = HELLO_TIMEOUT_S }, none = {0};
+    setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int ok = send_all(hello, proto_write_hello(hello, PROTO_VERSION)) == 0 &&
+             recv_all(hello, sizeof(hello)) == 0 && proto_read_hello(hello, sizeof(hello), &version) == 1 &&
+             version >= 1 && version <= PROTO_VERSION;
+    setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &none, sizeof(none));
+    if (ok) {
+        protocol = version;
+        return 0;
+    }
+
+    printf("⚠️ El servidor no entiende el protocolo v%d: se usa el protocolo anterior\n", PROTO_VERSION);
+    close(clientfd);
+    protocol = 1;
+    return connect_server();
+}
+
+// Las opciones y la página solo viajan en v3
+static int send_search(uint32_t id, const ProtoSearch *q) {
+    if (protocol == 1) {
+        // arousal + emoción + artista, en un solo send
+        char request[sizeof(int) + 2 * MAX_FIELD] = "";
+        memcpy(request, &q->arousal, sizeof(int));
+        snprintf(request + sizeof(int), MAX_FIELD, "%s", q->emotion);
+        snprintf(request + sizeof(int) + MAX_FIELD, MAX_FIELD, "%s", q->artist);
+        return send_all(request, sizeof(request));
+    }
+    uint8_t msg[PROTO_SEARCH_MAX_BYTES];
+    return send_all(msg, proto_write_search(msg, protocol, id, q));
+}
+
+// Envía la búsqueda y devuelve la cantidad de canciones (SEARCH_BUSY si el servidor
+// está saturado), o -2 si se perdió la conexión. Es la única búsqueda en curso.
+static long search(uint32_t id, const ProtoSearch *q) {
+    long found = 0;
+    if (send_search(id, q) != 0) return -2;
+    if (protocol == 1) return recv_all(&found, sizeof(long)) == 0 ? found : -2;
+
+    uint8_t msg[PROTO_MAX_HEADER_BYTES + PROTO_MAX_PAYLOAD];
+    ProtoFrame frame;
+    uint64_t count;
+    if (recv_message(&frame, msg) != 0 || frame.id != id) return -2;
+    if (frame.type == PROTO_MSG_BUSY) return SEARCH_BUSY;
+    if (frame.type != PROTO_MSG_COUNT || proto_read_count(&frame, &count) != 0) return -2;
+    return (long)count;
+}
+
+static int send_confirm(uint32_t id, int send_songs) {
+    if (protocol == 1) {
+        char confirm = send_songs ? 'y' : 'n';
+        return send_all(&confirm, 1);
+    }
+    uint8_t msg[PROTO_MAX_HEADER_BYTES + 1];
+    return send_all(msg, proto_write_confirm(msg, protocol, id, send_songs));
+}
+
+// v3: pide las canciones [offset, offset + limit) de una búsqueda que espera confirmación
+static int send_fetch(uint32_t id, uint32_t offset, uint32_t limit) {
+    uint8_t msg[PROTO_MAX_HEADER_BYTES + 8];
+    return send_all(msg, proto_write_fetch(msg, protocol, id, offset, limit));
+}
+
+// Recibe la siguiente canción. Devuelve 1 si llegó una, 0 al terminar y -1 si hubo un error.
+static int recv_song(Song *s) {
+    if (protocol == 1) {
+        if (recv_all(s, sizeof(Song)) != 0) return -1;
+        return strlen(s->track) > 0; // Un Song vacío es el terminador
+    }
+
+    uint8_t msg[PROTO_MAX_HEADER_BYTES + PROTO_MAX_PAYLOAD];
+    ProtoFrame frame;
+    if (recv_message(&frame, msg) != 0) return -1;
+    if (frame.type == PROTO_MSG_END) return 0;
+    return frame.type == PROTO_MSG_SONG && proto_read_song(&frame, s) == 0 ? 1 : -1;
+}
+
+// ------------- MODO POR LOTES (--batch) -------------
+// Lee búsquedas de un archivo, una por línea: emoción,arousal,artista. Con v3 mantiene
+// hasta `window` búsquedas en vuelo en la conexión y pide las canciones junto con la
+// búsqueda, así que cada una no paga las idas y vueltas de la confirmación.
+// --count-only pide solo las cantidades y --limit=N las primeras N canciones de cada
+// búsqueda; con v3 el servidor no lee del CSV las que no se envían.
+
+typedef struct {
+    int arousal;
+    char emotion[MAX_FIELD];
+    char artist[MAX_FIELD];
+    long found;
+} BatchQuery;
+
+static int load_batch(const char *path, BatchQuery **queries) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror("❌ Error abriendo el archivo de búsquedas");
+        return -1;
+    }
+    int count = 0, capacity = 0;
+    char line[3 * MAX_FIELD];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *arousal = strchr(line, ','), *artist = arousal ? strchr(arousal + 1, ',') : NULL;
+        if (line[0] == '#' || !artist) continue;
+        *arousal++ = '\0';
+        *artist++ = '\0';
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            BatchQuery *grown = realloc(*queries, sizeof(BatchQuery) * capacity);
+            if (!grown) break;
+            *queries = grown;
+        }
+        BatchQuery *q = &(*queries)[count];
+        q->arousal = atoi(arousal);
+        q->found = 0;
+        snprintf(q->emotion, MAX_FIELD, "%.*s", MAX_FIELD - 1, line);
+        snprintf(q->artist, MAX_FIELD, "%.*s", MAX_FIELD - 1, artist);
+        sanitize_input(q->emotion);
+        sanitize_input(q->artist);
+        if (q->emotion[0] && q->artist[0] && q->arousal >= 0 && q->arousal <= 100) count++;
     }
+    fclose(file);
+    return count;
+}
 
-    printf("✅ Conectado al servidor (Searcher) en %s:%d\n", HOST, PORT);
+static void batch_search(const BatchQuery *q, uint8_t options, uint32_t limit, ProtoSearch *search) {
+    memset(search, 0, sizeof(*search));
+    search->options = options;
+    search->arousal = q->arousal;
+    memcpy(search->emotion, q->emotion, MAX_FIELD);
+    memcpy(search->artist, q->artist, MAX_FIELD);
+    search->limit = limit;
+}
+
+static void print_batch_song(uint32_t id, const Song *s) {
+    printf("   [%u] 🎵 %s — %s\n", id, s->track, s->artist);
+}
+
+static void print_batch_result(uint32_t id, const BatchQuery *q) {
+    if (q->found == SEARCH_BUSY)
+        printf("⏳ #%u %s/%d/%s: servidor ocupado\n", id, q->emotion, q->arousal, q->artist);
+    else
+        printf("🔎 #%u %s/%d/%s: %ld canciones\n", id, q->emotion, q->arousal, q->artist, q->found);
+}
+
+// v1/v2: una búsqueda por vez, con su confirmación. Sin páginas en el protocolo, con
+// `limit` llegan todas las canciones y se muestran las primeras.
+static int run_batch_lockstep(BatchQuery *queries, int count, int count_only, uint32_t limit, long *songs) {
+    for (int i = 0; i < count; i++) {
+        BatchQuery *q = &queries[i];
+        ProtoSearch request;
+        batch_search(q, 0, 0, &request);
+        q->found = search(0, &request);
+        if (q->found == -2) return -1;
+        if (q->found > 0) {
+            Song s;
+            int got = 0;
+            uint32_t shown = 0;
+            if (send_confirm(0, !count_only) != 0) return -1;
+            while (!count_only && (got = recv_song(&s)) == 1) {
+                if (limit > 0 && shown == limit) continue;
+                print_batch_song(i + 1, &s);
+                shown++;
+                (*songs)++;
+            }
+            if (!count_only && got < 0) return -1;
+        }
+        print_batch_result(i + 1, q);
+    }
+    return 0;
+}
+
+// v3: la búsqueda i lleva el id i + 1; las respuestas llegan en cualquier orden
+static int run_batch_pipelined(BatchQuery *queries, int count, int window, int count_only, uint32_t limit,
+                               long *songs) {
+    uint8_t options = count_only ? PROTO_SEARCH_COUNT_ONLY : PROTO_SEARCH_SONGS | (limit > 0 ? PROTO_SEARCH_PAGE : 0);
+    uint8_t msg[PROTO_MAX_HEADER_BYTES + PROTO_MAX_PAYLOAD];
+    int sent = 0, finished = 0;
+    while (finished < count) {
+        for (; sent < count && sent - finished < window; sent++) {
+            ProtoSearch request;
+            batch_search(&queries[sent], options, limit, &request);
+            if (send_search(sent + 1, &request) != 0) return -1;
+        }
+
+        ProtoFrame frame;
+        if (recv_message(&frame, msg) != 0 || frame.id < 1 || frame.id > (uint32_t)sent) return -1;
+        BatchQuery *q = &queries[frame.id - 1];
+        uint64_t found;
+        Song s;
+        switch (frame.type) {
+        case PROTO_MSG_COUNT:
+            if (proto_read_count(&frame, &found) != 0) return -1;
+            q->found = (long)found;
+            if (count_only) { // La cantidad cierra la búsqueda
+                print_batch_result(frame.id, q);
+                finished++;
+            }
+            break;
+        case PROTO_MSG_SONG:
+            if (proto_read_song(&frame, &s) != 0) return -1;
+            print_batch_song(frame.id, &s);
+            (*songs)++;
+            break;
+        case PROTO_MSG_BUSY:
+            q->found = SEARCH_BUSY;
+            /* fall through */
+        case PROTO_MSG_END:
+            print_batch_result(frame.id, q);
+            finished++;
+            break;
+        default:
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int run_batch(const char *path, int window, int count_only, uint32_t limit) {
+    BatchQuery *queries = NULL;
+    int count = load_batch(path, &queries);
+    if (count < 0) return 1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long songs = 0;
+    int status = protocol >= 3 ? run_batch_pipelined(queries, count, window, count_only, limit, &songs)
+                               : run_batch_lockstep(queries, count, count_only, limit, &songs);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(queries);
+    if (status != 0) {
+        printf("❌ Error recibiendo datos del servidor.\n");
+        return 1;
+    }
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (secs <= 0) secs = 1e-9;
+    printf("✅ %d búsquedas, %ld canciones en %.2f s (%.0f búsquedas/s, protocolo v%d, %d en vuelo)\n",
+           count, songs, secs, count / secs, protocol, protocol >= 3 ? window : 1);
+    return 0;
+}
+
+void mostrarMenuPrincipal() {
+    printf("\n\n====================\n");
+    printf("🌟 Menú Principal:\n");
+    printf("1. Ingresar emoción ❤️ \n");
+    printf("2. Ingresar la intensidad (0-100) 🎚️\n");
+    printf("3. Ingresar el artista 🎤\n");
+    printf("4. Realizar la búsqueda 🔍\n");
+    printf("9. Salir\n");
+    printf("Seleccione una opción: ");
+}
+
+
+int main(int argc, char *argv[]) {
+    const char *batch_path = NULL;
+    int window = BATCH_WINDOW, count_only = 0;
+    uint32_t limit = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--batch=", 8) == 0) batch_path = argv[i] + 8;
+        else if (strncmp(argv[i], "--window=", 9) == 0 && atoi(argv[i] + 9) > 0) window = atoi(argv[i] + 9);
+        else if (strcmp(argv[i], "--count-only") == 0) count_only = 1;
+        else if (strncmp(argv[i], "--limit=", 8) == 0 && atoi(argv[i] + 8) > 0) limit = (uint32_t)atoi(argv[i] + 8);
+        else {
+            fprintf(stderr, "Uso: %s [--batch=<archivo> [--window=N] [--count-only | --limit=N]]\n", argv[0]);
+            return 1;
+        }
+    }
+    signal(SIGINT, handle_sigint);
+
+    // Conectar al servidor y acordar el protocolo
+    if (connect_server() != 0 || negotiate_protocol() != 0) exit(EXIT_FAILURE);
+
+    if (batch_path) {
+        int status = run_batch(batch_path, window, count_only, limit);
+        close(clientfd);
+        return status;
+    }
+
+    printf("✅ Conectado al servidor (Searcher) en %s:%d (protocolo v%d)\n", HOST, PORT, protocol);
     printf("\n\n\n   >⩊< Bienvenido al buscador de canciones por sentimientos ▶︎ •\n");
 
     // --- Lógica de la Interface ---
@@ -117,18 +431,22 @@ int main() {
                     continue;
                 }
                 
-                // Enviar datos al servidor
-                send(clientfd, &arousal, sizeof(int), 0);
-                send(clientfd, emotion, sizeof(emotion), 0);
-                send(clientfd, artist, sizeof(artist), 0);
-
-                // Recibir cantidad de resultados
-                long total_encontradas = 0;
-                if (recv(clientfd, &total_encontradas, sizeof(long), 0) <= 0) {
+                // Enviar la búsqueda y recibir la cantidad de resultados
+                uint32_t id = ++next_request_id;
+                ProtoSearch request = { .arousal = arousal };
+                memcpy(request.emotion, emotion, MAX_FIELD);
+                memcpy(request.artist, artist, MAX_FIELD);
+                long total_encontradas = search(id, &request);
+                if (total_encontradas == -2) {
                     printf("❌ Error recibiendo datos del servidor.\n");
                     break;
                 }
 
+                if (total_encontradas == SEARCH_BUSY) {
+                    printf("\n⏳ El servidor está ocupado. Intenta de nuevo en unos segundos.\n");
+                    continue;
+                }
+
                 if (total_encontradas == 0) {
                     printf("\n❌ No se encontraron canciones con ese criterio.\n");
                     continue;
@@ -137,21 +455,36 @@ int main() {
                 printf("\n🎵 Se encontraron %ld canciones. ¿Desea mostrarlas? (s/n): ", total_encontradas);
                 char respuesta[4];
                 if (!fgets(respuesta, sizeof(respuesta), stdin)) continue;
-                char confirm = (tolower(respuesta[0]) == 's') ? 'y' : 'n';
+                int confirm = tolower(respuesta[0]) == 's';
 
-                send(clientfd, &confirm, 1, 0); // Enviar confirmación
-
-                if (confirm == 'y') {
+                if (confirm && protocol >= 3) {
+                    // De a una página: el servidor solo lee las canciones que se muestran
+                    long song_count = 0;
+                    int got = 0;
+                    Song s;
+                    while (send_fetch(id, (uint32_t)song_count, PAGE_SIZE) == 0) {
+                        while ((got = recv_song(&s)) == 1) {
+                            printSong(s);
+                            song_count++;
+                        }
+                        if (got < 0 || song_count >= total_encontradas) break;
+                        printf("\n📄 Mostradas %ld de %ld. ¿Ver las siguientes %d? (s/n): ", song_count,
+                               total_encontradas, PAGE_SIZE);
+                        if (!fgets(respuesta, sizeof(respuesta), stdin) || tolower(respuesta[0]) != 's') break;
+                    }
+                    send_confirm(id, 0); // Cerrar la búsqueda
+                    printf("\n✅ Total de canciones mostradas: %ld\n", song_count);
+                } else if (confirm) {
+                    send_confirm(id, 1); // Enviar confirmación
                     int song_count = 0;
-                    while (1) {
-                        Song s;
-                        if (recv(clientfd, &s, sizeof(Song), 0) <= 0) break;
-                        if (strlen(s.track) == 0) break; // Es el terminador
+                    Song s;
+                    while (recv_song(&s) == 1) {
                         printSong(s);
                         song_count++;
                     }
                      printf("\n✅ Total de canciones mostradas: %d\n", song_count);
                 } else {
+                    send_confirm(id, 0); // Enviar confirmación
                      printf("📭 Resultados omitidos. Volviendo al menú...\n");
                 }
                 break;
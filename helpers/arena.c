@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+void arena_init(Arena *arena, size_t block_size) {
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+    arena->reserved = 0;
+    arena->used = 0;
+    arena->blocks = 0;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    // Una arena en cero (sin arena_init) usa el tamaño de bloque por defecto
+    if (!arena->block_size) arena->block_size = ARENA_BLOCK_SIZE;
+
+    ArenaBlock *block = arena->head;
+    if (!block || block->size - block->used < size) {
+        // Las asignaciones más grandes que un bloque reciben un bloque propio
+        size_t data_size = size > arena->block_size ? size : arena->block_size;
+        block = malloc(sizeof(ArenaBlock) + data_size);
+        if (!block) {
+            perror("[arena] malloc");
+            return NULL;
+        }
+        block->size = data_size;
+        block->used = 0;
+
+        // Un bloque dedicado va detrás del actual para no desperdiciar su espacio libre
+        if (arena->head && data_size > arena->block_size) {
+            block->next = arena->head->next;
+            arena->head->next = block;
+        } else {
+            block->next = arena->head;
+            arena->head = block;
+        }
+        arena->reserved += sizeof(ArenaBlock) + data_size;
+        arena->blocks++;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    arena->used += size;
+    return ptr;
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size) {
+    void *ptr = arena_alloc(arena, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+char *arena_strdup(Arena *arena, const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = arena_alloc(arena, len);
+    if (copy) memcpy(copy, str, len);
+    return copy;
+}
+
+void arena_release(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena, arena->block_size);
+}
@@ -0,0 +1,42 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (1 << 20) // 1 MB por bloque
+#define ARENA_ALIGN 8
+
+// Bloque de memoria de una arena; los bloques se encadenan y se liberan juntos
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaBlock;
+
+// Arena de asignación por "bump pointer": asignar es avanzar un puntero
+// y liberar todo lo asignado es una sola llamada a arena_release.
+typedef struct {
+    ArenaBlock *head;
+    size_t block_size;
+    size_t reserved;   // Bytes pedidos al sistema (bloques completos)
+    size_t used;       // Bytes entregados a los usuarios de la arena
+    size_t blocks;
+} Arena;
+
+// Inicializa una arena vacía; block_size 0 usa ARENA_BLOCK_SIZE
+void arena_init(Arena *arena, size_t block_size);
+
+// Devuelve memoria alineada a ARENA_ALIGN, o NULL si no hay memoria
+void *arena_alloc(Arena *arena, size_t size);
+
+// Igual que arena_alloc pero con la memoria en cero
+void *arena_calloc(Arena *arena, size_t count, size_t size);
+
+// Copia un string dentro de la arena
+char *arena_strdup(Arena *arena, const char *str);
+
+// Libera todos los bloques de la arena y la deja lista para reutilizarse
+void arena_release(Arena *arena);
+
+#endif
@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "artist_dict.h"
+
+uint64_t artist_hash(const char *name) {
+    uint64_t hash = 1469598103934665603ULL;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+uint32_t artist_id_hash(uint32_t id) {
+    id ^= id >> 16;
+    id *= 0x85ebca6bU;
+    id ^= id >> 13;
+    id *= 0xc2b2ae35U;
+    id ^= id >> 16;
+    return id;
+}
+
+void hash_probe_record(HashProbeStats *stats, uint32_t probes) {
+    stats->lookups++;
+    stats->probes += probes;
+    if (probes > stats->max_probe) stats->max_probe = probes;
+}
+
+void hash_probe_report(const char *label, const HashProbeStats *stats, uint64_t entries, uint64_t slots) {
+    printf("[hash] %s: %lu entradas en %lu casillas (carga %.2f), sondeo medio %.2f, máximo %u\n",
+           label, (unsigned long)entries, (unsigned long)slots,
+           slots ? (double)entries / slots : 0.0,
+           stats->lookups ? (double)stats->probes / stats->lookups : 0.0,
+           stats->max_probe);
+}
+
+int hash_probe_check(const char *label, const HashProbeStats *stats) {
+    double mean = stats->lookups ? (double)stats->probes / stats->lookups : 0.0;
+    if (mean <= HASH_PROBE_MEAN_LIMIT && stats->max_probe <= HASH_PROBE_MAX_LIMIT) return 0;
+    fprintf(stderr, "❌ [hash] %s: sondeo medio %.2f (límite %.2f), máximo %u (límite %u)\n",
+            label, mean, HASH_PROBE_MEAN_LIMIT, stats->max_probe, HASH_PROBE_MAX_LIMIT);
+    return -1;
+}
+
+// ------------- CONSTRUCCIÓN -------------
+
+// Inserta un id en una tabla sin duplicados ni necesidad de crecer
+static void slots_insert(ArtistHashSlot *slots, uint32_t slot_count, uint64_t hash, uint32_t id) {
+    uint32_t mask = slot_count - 1;
+    uint32_t slot = (uint32_t)hash & mask;
+    while (slots[slot].id_plus_one) slot = (slot + 1) & mask;
+    slots[slot].tag = (uint32_t)(hash >> 32);
+    slots[slot].id_plus_one = id + 1;
+}
+
+static int artist_dict_grow(ArtistDictBuilder *dict) {
+    uint32_t slot_count = dict->slot_count ? dict->slot_count * 2 : HASH_MIN_SLOTS * 128;
+    ArtistHashSlot *slots = calloc(slot_count, sizeof(ArtistHashSlot));
+    if (!slots) {
+        perror("[artist_dict] calloc");
+        return -1;
+    }
+    for (uint32_t id = 0; id < dict->count; id++)
+        slots_insert(slots, slot_count, artist_hash(dict->names[id]), id);
+
+    free(dict->slots);
+    dict->slots = slots;
+    dict->slot_count = slot_count;
+    return 0;
+}
+
+void artist_dict_probe_stats(const ArtistDictBuilder *dict, HashProbeStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    uint32_t mask = dict->slot_count - 1;
+    for (uint32_t slot = 0; slot < dict->slot_count; slot++) {
+        const ArtistHashSlot *s = &dict->slots[slot];
+        if (s->id_plus_one == 0) continue;
+        uint32_t home = (uint32_t)artist_hash(dict->names[s->id_plus_one - 1]) & mask;
+        hash_probe_record(stats, ((slot - home) & mask) + 1);
+    }
+}
+
+uint32_t artist_dict_intern(ArtistDictBuilder *dict, const char *name) {
+    if ((uint64_t)(dict->count + 1) * ARTIST_DICT_MAX_LOAD_DEN >
+            (uint64_t)dict->slot_count * ARTIST_DICT_MAX_LOAD_NUM &&
+        artist_dict_grow(dict) != 0)
+        return ARTIST_ID_NONE;
+
+    uint64_t hash = artist_hash(name);
+    uint32_t tag = (uint32_t)(hash >> 32);
+    uint32_t mask = dict->slot_count - 1;
+    uint32_t slot = (uint32_t)hash & mask;
+    uint32_t probes = 1;
+    while (dict->slots[slot].id_plus_one) {
+        const ArtistHashSlot *s = &dict->slots[slot];
+        if (s->tag == tag && strcmp(dict->names[s->id_plus_one - 1], name) == 0) {
+            hash_probe_record(&dict->stats, probes);
+            return s->id_plus_one - 1;
+        }
+        slot = (slot + 1) & mask;
+        probes++;
+    }
+    hash_probe_record(&dict->stats, probes);
+
+    if (dict->count == 0 && dict->dictionary_id == 0)
+        dict->dictionary_id = ((uint64_t)time(NULL) << 32) ^ ((uint64_t)getpid() << 16) ^ (uint64_t)clock();
+
+    if (dict->count == dict->capacity) {
+        uint32_t capacity = dict->capacity ? dict->capacity * 2 : 1024;
+        const char **names = realloc(dict->names, sizeof(char *) * capacity);
+        if (!names) {
+            perror("[artist_dict] realloc");
+            return ARTIST_ID_NONE;
+        }
+        dict->names = names;
+        dict->capacity = capacity;
+    }
+
+    char *copy = arena_strdup(&dict->arena, name);
+    if (!copy) return ARTIST_ID_NONE;
+
+    uint32_t id = dict->count;
+    dict->names[dict->count++] = copy;
+    dict->slots[slot].tag = tag;
+    dict->slots[slot].id_plus_one = id + 1;
+    return id;
+}
+
+typedef struct {
+    const char *name;
+    uint32_t id;
+} NamedId;
+
+static int compare_named_ids(const void *a, const void *b) {
+    return strcmp(((const NamedId *)a)->name, ((const NamedId *)b)->name);
+}
+
+int artist_dict_save(const ArtistDictBuilder *dict, const char *path) {
+    uint32_t count = dict->count;
+    uint32_t slots = HASH_MIN_SLOTS;
+    while ((uint64_t)count * ARTIST_DICT_MAX_LOAD_DEN > (uint64_t)slots * ARTIST_DICT_MAX_LOAD_NUM) slots <<= 1;
+
+    uint32_t *offsets = malloc(sizeof(uint32_t) * (count + 1));
+    uint32_t *sorted = malloc(sizeof(uint32_t) * (count ? count : 1));
+    ArtistHashSlot *table = calloc(slots, sizeof(ArtistHashSlot));
+    NamedId *order = malloc(sizeof(NamedId) * (count ? count : 1));
+    if (!offsets || !sorted || !table || !order) {
+        perror("[artist_dict] malloc");
+        free(offsets); free(sorted); free(table); free(order);
+        return -1;
+    }
+
+    uint32_t names_size = 0;
+    for (uint32_t id = 0; id < count; id++) {
+        offsets[id] = names_size;
+        names_size += strlen(dict->names[id]) + 1;
+
+        order[id].name = dict->names[id];
+        order[id].id = id;
+        slots_insert(table, slots, artist_hash(dict->names[id]), id);
+    }
+    offsets[count] = names_size;
+
+    qsort(order, count, sizeof(NamedId), compare_named_ids);
+    for (uint32_t i = 0; i < count; i++) sorted[i] = order[i].id;
+
+    ArtistDictHeader hdr = {0};
+    memcpy(hdr.magic, ARTIST_DICT_MAGIC, sizeof(ARTIST_DICT_MAGIC));
+    hdr.version = ARTIST_DICT_VERSION;
+    hdr.artist_count = count;
+    hdr.hash_slots = slots;
+    hdr.dictionary_id = dict->dictionary_id;
+    hdr.offsets_offset = sizeof(ArtistDictHeader);
+    hdr.sorted_offset = hdr.offsets_offset + sizeof(uint32_t) * (count + 1);
+    hdr.hash_offset = hdr.sorted_offset + sizeof(uint32_t) * count;
+    hdr.names_offset = hdr.hash_offset + sizeof(ArtistHashSlot) * slots;
+    hdr.file_size = hdr.names_offset + names_size;
+
+    // Se escribe aparte y se renombra: un servidor con el archivo mapeado nunca lo ve a medias
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    int rc = -1;
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f) {
+        perror("[artist_dict] fopen");
+    } else {
+        // Una escritura corta no debe reemplazar al diccionario anterior
+        int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+                 fwrite(offsets, sizeof(uint32_t), count + 1, f) == count + 1 &&
+                 fwrite(sorted, sizeof(uint32_t), count, f) == count &&
+                 fwrite(table, sizeof(ArtistHashSlot), slots, f) == slots;
+        for (uint32_t id = 0; id < count && ok; id++) {
+            size_t len = offsets[id + 1] - offsets[id];
+            ok = fwrite(dict->names[id], sizeof(char), len, f) == len;
+        }
+        if (!ok) perror("[artist_dict] fwrite");
+        if (fclose(f) != 0) {
+            perror("[artist_dict] fclose");
+            ok = 0;
+        }
+        rc = ok ? 0 : -1;
+        if (rc == 0 && rename(tmp_path, path) != 0) {
+            perror("[artist_dict] rename");
+            rc = -1;
+        }
+        if (rc != 0) unlink(tmp_path);
+    }
+
+    free(offsets);
+    free(sorted);
+    free(table);
+    free(order);
+    return rc;
+}
+
+void artist_dict_reset(ArtistDictBuilder *dict) {
+    arena_release(&dict->arena);
+    free(dict->slots);
+    free(dict->names);
+    memset(dict, 0, sizeof(*dict));
+}
+
+// ------------- LECTURA DEL DICCIONARIO MAPEADO -------------
+
+int artist_dict_load(ArtistDictBuilder *dict, const char *path) {
+    ArtistDictionary mapped = {0};
+    if (map_artist_dictionary(&mapped, path) != 0) return -1;
+
+    artist_dict_reset(dict);
+    dict->dictionary_id = mapped.header->dictionary_id;
+
+    // Se internan en orden de id para que cada nombre conserve el suyo
+    int rc = 0;
+    for (uint32_t id = 0; id < mapped.header->artist_count; id++) {
+        const char *name = artist_dictionary_name(&mapped, id);
+        if (!name || artist_dict_intern(dict, name) != id) {
+            fprintf(stderr, "[artist_dict] Diccionario inconsistente en el id %u: %s\n", id, path);
+            rc = -1;
+            break;
+        }
+    }
+    unmap_artist_dictionary(&mapped);
+    if (rc != 0) artist_dict_reset(dict);
+    else memset(&dict->stats, 0, sizeof(dict->stats));
+    return rc;
+}
+
+int map_artist_dictionary(ArtistDictionary *dict, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("[map_artist_dictionary] No se pudo abrir el diccionario de artistas");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ArtistDictHeader)) {
+        fprintf(stderr, "[map_artist_dictionary] Archivo demasiado pequeño: %s\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("[map_artist_dictionary] mmap");
+        return -1;
+    }
+
+    const ArtistDictHeader *hdr = map;
+    uint64_t size = (uint64_t)st.st_size;
+    int valid = memcmp(hdr->magic, ARTIST_DICT_MAGIC, sizeof(ARTIST_DICT_MAGIC)) == 0 &&
+        hdr->version == ARTIST_DICT_VERSION &&
+        hdr->file_size == size &&
+        (uint64_t)hdr->hash_slots * HASH_MAX_LOAD_NUM >= (uint64_t)hdr->artist_count * HASH_MAX_LOAD_DEN &&
+        hdr->hash_slots > hdr->artist_count &&
+        (hdr->hash_slots & (hdr->hash_slots - 1)) == 0 &&
+        hdr->offsets_offset == sizeof(ArtistDictHeader) &&
+        hdr->sorted_offset == hdr->offsets_offset + sizeof(uint32_t) * ((uint64_t)hdr->artist_count + 1) &&
+        hdr->hash_offset == hdr->sorted_offset + sizeof(uint32_t) * (uint64_t)hdr->artist_count &&
+        hdr->names_offset == hdr->hash_offset + sizeof(ArtistHashSlot) * (uint64_t)hdr->hash_slots &&
+        hdr->names_offset <= size;
+
+    if (valid) {
+        // El último offset debe cerrar exactamente el pool de nombres
+        const uint32_t *offsets = (const uint32_t *)((const char *)map + hdr->offsets_offset);
+        valid = offsets[hdr->artist_count] == size - hdr->names_offset &&
+                (size == hdr->names_offset || ((const char *)map)[size - 1] == '\0');
+    }
+
+    if (!valid) {
+        fprintf(stderr, "[map_artist_dictionary] Formato inválido o desactualizado: %s\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    dict->map = map;
+    dict->map_size = st.st_size;
+    dict->header = hdr;
+    dict->name_offsets = (const uint32_t *)((const char *)map + hdr->offsets_offset);
+    dict->sorted_ids = (const uint32_t *)((const char *)map + hdr->sorted_offset);
+    dict->hash_slots = (const ArtistHashSlot *)((const char *)map + hdr->hash_offset);
+    dict->names = (const char *)map + hdr->names_offset;
+    return 0;
+}
+
+void unmap_artist_dictionary(ArtistDictionary *dict) {
+    if (dict->map) munmap(dict->map, dict->map_size);
+    memset(dict, 0, sizeof(*dict));
+}
+
+const char *artist_dictionary_name(const ArtistDictionary *dict, uint32_t id) {
+    if (!dict->map || id >= dict->header->artist_count) return NULL;
+    uint32_t offset = dict->name_offsets[id];
+    if (offset >= dict->name_offsets[dict->header->artist_count]) return NULL;
+    return dict->names + offset;
+}
+
+uint32_t artist_dictionary_find(const ArtistDictionary *dict, const char *name) {
+    if (!dict->map) return ARTIST_ID_NONE;
+
+    uint64_t hash = artist_hash(name);
+    uint32_t tag = (uint32_t)(hash >> 32);
+    uint32_t mask = dict->header->hash_slots - 1;
+    uint32_t slot = (uint32_t)hash & mask;
+    for (uint32_t probes = 0; probes <= mask; probes++) {
+        const ArtistHashSlot *s = &dict->hash_slots[slot];
+        if (s->id_plus_one == 0) return ARTIST_ID_NONE;
+
+        if (s->tag == tag) {
+            const char *candidate = artist_dictionary_name(dict, s->id_plus_one - 1);
+            if (candidate && strcmp(candidate, name) == 0) return s->id_plus_one - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return ARTIST_ID_NONE;
+}
+
+void artist_dictionary_probe_stats(const ArtistDictionary *dict, HashProbeStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!dict->map) return;
+
+    // El largo de sondeo de cada entrada es su distancia a la casilla ideal
+    uint32_t mask = dict->header->hash_slots - 1;
+    for (uint32_t slot = 0; slot <= mask; slot++) {
+        const ArtistHashSlot *s = &dict->hash_slots[slot];
+        if (s->id_plus_one == 0) continue;
+        const char *name = artist_dictionary_name(dict, s->id_plus_one - 1);
+        if (!name) continue;
+        uint32_t home = (uint32_t)artist_hash(name) & mask;
+        hash_probe_record(stats, ((slot - home) & mask) + 1);
+    }
+}
@@ -0,0 +1,138 @@
+#ifndef ARTIST_DICT_H
+#define ARTIST_DICT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#define ARTIST_DICT_FILE "artists.bin"
+#define ARTIST_DICT_MAGIC "MUSEART"
+#define ARTIST_DICT_VERSION 2
+#define ARTIST_ID_NONE UINT32_MAX
+
+// Las tablas de direccionamiento abierto crecen al doble al superar 3/4 de ocupación
+#define HASH_MIN_SLOTS 8
+#define HASH_MAX_LOAD_NUM 3
+#define HASH_MAX_LOAD_DEN 4
+
+// El diccionario usa sondeo lineal sin Robin Hood (sus casillas no guardan el hash
+// completo): se mantiene a media carga para que ningún racimo se alargue
+#define ARTIST_DICT_MAX_LOAD_NUM 1
+#define ARTIST_DICT_MAX_LOAD_DEN 2
+
+// Sondeo aceptable en la ubicación final de una tabla. A 3/4 de carga el sondeo medio
+// esperado es 2.5 (el límite deja margen para una tabla a punto de crecer) y el máximo
+// no pasa de unas decenas. Más indica agrupamiento.
+#define HASH_PROBE_MEAN_LIMIT 3.0
+#define HASH_PROBE_MAX_LIMIT 64
+
+// Formato en disco de artists.bin, compartido por todos los index_<emoción>.bin:
+//   [ArtistDictHeader]
+//   [uint32_t x (artist_count + 1)]  offset del nombre de cada id (el último marca el fin)
+//   [uint32_t x artist_count]        ids ordenados por nombre
+//   [ArtistHashSlot x hash_slots]    tabla hash con sondeo lineal
+//   [nombres terminados en '\0']
+// Los ids se asignan en orden de aparición y nunca cambian, así que un
+// diccionario puede crecer sin invalidar los índices escritos antes.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t artist_count;
+    uint32_t hash_slots;      // Potencia de 2
+    uint32_t reserved;
+    uint64_t dictionary_id;   // Identifica el diccionario en los índices por emoción
+    uint64_t offsets_offset;
+    uint64_t sorted_offset;
+    uint64_t hash_offset;
+    uint64_t names_offset;
+    uint64_t file_size;
+} ArtistDictHeader;
+
+// Casilla de una tabla hash de artistas (en disco y en memoria).
+// `tag` son los 32 bits altos del hash: solo se compara el nombre si coincide.
+typedef struct {
+    uint32_t tag;
+    uint32_t id_plus_one;     // 0 = casilla vacía
+} ArtistHashSlot;
+
+// Estadísticas de sondeo de una tabla hash
+typedef struct {
+    uint64_t lookups;
+    uint64_t probes;          // Casillas visitadas en total
+    uint32_t max_probe;
+} HashProbeStats;
+
+// Diccionario en construcción (indexador). No es thread-safe: el llamador
+// debe serializar el acceso (add_position lo usa con index_mutex tomado).
+typedef struct {
+    ArtistHashSlot *slots;
+    uint32_t slot_count;      // Potencia de 2
+    const char **names;       // Nombre de cada id
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t dictionary_id;
+    Arena arena;
+    HashProbeStats stats;
+} ArtistDictBuilder;
+
+// Diccionario mapeado en memoria (servidor)
+typedef struct {
+    void *map;
+    size_t map_size;
+    const ArtistDictHeader *header;
+    const uint32_t *name_offsets;
+    const uint32_t *sorted_ids;
+    const ArtistHashSlot *hash_slots;
+    const char *names;
+} ArtistDictionary;
+
+// Hash de 64 bits para nombres de artista (el mismo en disco y en memoria):
+// FNV-1a seguido del mezclador final de MurmurHash3 para repartir bien los bits bajos.
+uint64_t artist_hash(const char *name);
+
+// Mezclador de enteros para tablas indexadas por id de artista
+uint32_t artist_id_hash(uint32_t id);
+
+// Acumula una búsqueda que visitó `probes` casillas
+void hash_probe_record(HashProbeStats *stats, uint32_t probes);
+
+// Imprime las estadísticas de sondeo de una tabla
+void hash_probe_report(const char *label, const HashProbeStats *stats, uint64_t entries, uint64_t slots);
+
+// Compara la ubicación final de una tabla con HASH_PROBE_MEAN_LIMIT y HASH_PROBE_MAX_LIMIT.
+// Si los supera lo avisa y devuelve -1.
+int hash_probe_check(const char *label, const HashProbeStats *stats);
+
+// Devuelve el id de un artista, asignándole uno nuevo si no existía
+uint32_t artist_dict_intern(ArtistDictBuilder *dict, const char *name);
+
+// Calcula el largo de sondeo de todas las entradas del diccionario en construcción
+void artist_dict_probe_stats(const ArtistDictBuilder *dict, HashProbeStats *stats);
+
+// Escribe el diccionario en disco. Devuelve 0 si todo salió bien.
+int artist_dict_save(const ArtistDictBuilder *dict, const char *path);
+
+// Libera el diccionario en construcción y lo deja vacío
+void artist_dict_reset(ArtistDictBuilder *dict);
+
+// Carga artists.bin en un diccionario en construcción, conservando ids y dictionary_id,
+// para seguir agregando artistas nuevos. Devuelve 0 si todo salió bien.
+int artist_dict_load(ArtistDictBuilder *dict, const char *path);
+
+// Mapea artists.bin. Devuelve 0 si el archivo es válido.
+int map_artist_dictionary(ArtistDictionary *dict, const char *path);
+
+// Libera el mapeo creado por map_artist_dictionary
+void unmap_artist_dictionary(ArtistDictionary *dict);
+
+// Resuelve un nombre (ya sanitizado) a su id, o ARTIST_ID_NONE si no existe
+uint32_t artist_dictionary_find(const ArtistDictionary *dict, const char *name);
+
+// Devuelve el nombre de un id, o NULL si está fuera de rango
+const char *artist_dictionary_name(const ArtistDictionary *dict, uint32_t id);
+
+// Calcula el largo de sondeo de todas las entradas del diccionario mapeado
+void artist_dictionary_probe_stats(const ArtistDictionary *dict, HashProbeStats *stats);
+
+#endif
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "csv.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Busca el primer byte igual a `a` o `b` en [p, end); devuelve `end` si no hay
+static inline const char *csv_find(const char *p, const char *end, char a, char b) {
+#if defined(__SSE2__)
+    // SSE2 es parte de x86-64: compara 16 bytes contra los dos delimitadores a la vez
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b);
+    while (end - p >= 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, va), _mm_cmpeq_epi8(bytes, vb)));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    for (; p < end; p++)
+        if (*p == a || *p == b) return p;
+    return end;
+}
+
+int csv_split_fields(const char *line, const char *end, CsvSpan *fields, int count) {
+    const char *p = line;
+    int present = 0, more = 1;
+    for (int i = 0; i < count; i++) {
+        const char *start = p;
+        if (more) {
+            present++;
+            while (p < end) {
+                p = csv_find(p, end, ',', '[');
+                if (p == end || *p == ',') break;
+                // Lista entre corchetes: sus comas son parte del campo
+                p = csv_find(p + 1, end, ']', ']');
+                if (p < end) p++;
+            }
+        }
+        fields[i].start = start;
+        fields[i].len = (size_t)(p - start);
+        more = more && p < end;
+        if (more) p++;
+    }
+    return present;
+}
+
+void csv_span_copy(char *dst, size_t size, const CsvSpan *span) {
+    size_t len = span->len < size - 1 ? span->len : size - 1;
+    memcpy(dst, span->start, len);
+    dst[len] = '\0';
+}
+
+double csv_span_atof(const CsvSpan *span) {
+    char buf[64];
+    csv_span_copy(buf, sizeof(buf), span);
+    return atof(buf);
+}
@@ -0,0 +1,25 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stddef.h>
+
+// Campo de una línea del CSV: apunta dentro de la línea, que no se modifica
+typedef struct {
+    const char *start;
+    size_t len;
+} CsvSpan;
+
+// Separa la línea [line, end) en `count` campos por comas. Las comas dentro de
+// una lista entre corchetes ("['a', 'b']") no separan campos. Los campos que
+// faltan quedan vacíos al final de la línea. Busca los delimitadores de a 16 bytes
+// con SSE2 cuando se compila para x86-64.
+// Devuelve la cantidad de campos que tenía la línea (hasta `count`).
+int csv_split_fields(const char *line, const char *end, CsvSpan *fields, int count);
+
+// Copia un campo a `dst` terminado en '\0', truncándolo si no cabe
+void csv_span_copy(char *dst, size_t size, const CsvSpan *span);
+
+// Valor numérico de un campo (como atof)
+double csv_span_atof(const CsvSpan *span);
+
+#endif
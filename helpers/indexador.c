@@ -3,69 +3,45 @@
 #include <string.h>
 #include <ctype.h>
 #include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <dirent.h>
+#include <time.h>
 
-#define MAX_FIELD 128
-#define MAX_SEEDS 10
-#define MAX_ARTIST_BUCKETS 211
-#define INDEX_FOLDER "./output/emotions/"
-#define LINE_BUFFER 4096
-#define NUM_FIELDS 12
-#define CHUNK_SIZE 500000
-#define NUM_THREADS 8
-
-// Declaraciones adelantadas
-typedef struct PosNode PosNode;
-typedef struct ArtistNode ArtistNode;
-
-// Definiciones completas
-struct PosNode {
-    long pos;
-    PosNode *next;
-};
-
-struct ArtistNode {
-    char artist[MAX_FIELD];
-    PosNode *positions;
-    ArtistNode *next;
-};
-
-typedef struct {
-    ArtistNode *buckets[MAX_ARTIST_BUCKETS];
-} ArousalIndex;
-
-typedef struct EmotionIndex {
-    char emotion[MAX_FIELD];
-    ArousalIndex *arousals;
-    struct EmotionIndex *next;
-} EmotionIndex;
-
-typedef struct {
-    int id;
-    char **lines;
-    long *positions;
-    long num_lines;
-} ThreadArgs;
-
-typedef struct {
-    long id;
-    char title[MAX_FIELD];
-    char artist[MAX_FIELD];
-    char url[MAX_FIELD];
-    char emotions[MAX_SEEDS][MAX_FIELD];
-    int num_seeds;
-    float valence;
-    float arousal;
-    float dominance;
-    char genre[MAX_FIELD];
-} Song;
+#include "indexador.h"
 
 // Global index
 EmotionIndex *emotion_index_head = NULL;
 pthread_mutex_t index_mutex = PTHREAD_MUTEX_INITIALIZER;
+ArtistDictBuilder artist_dict;
+size_t index_memory_budget = 0;
+int index_threads = NUM_THREADS;
+size_t index_chunk_bytes = CHUNK_BYTES;
+char index_folder[256] = INDEX_FOLDER;
+static HashProbeStats arousal_probe_stats;
+
+// Runs volcados a disco durante la construcción actual y emociones que aparecen en ellos
+static uint32_t spilled_runs;
+static char (*run_emotions)[MAX_FIELD];
+static int run_emotion_count, run_emotion_capacity;
+static uint64_t spilled_entries, spilled_slots;  // Tablas ya liberadas, para las estadísticas
+static HashProbeStats spilled_placement;          // Ubicación final de esas tablas
+static size_t peak_arena_bytes;
 
 // ------------- FUNCIONES AUXILIARES -------------
 
+int set_index_folder(const char *path) {
+    size_t len = strlen(path);
+    int slash = len > 0 && path[len - 1] == '/';
+    if (len == 0 || len + !slash >= sizeof(index_folder)) return -1;
+    memcpy(index_folder, path, len);
+    if (!slash) index_folder[len++] = '/';
+    index_folder[len] = '\0';
+    return 0;
+}
+
 void sanitize_input(char *str) {
     char *src = str, *dst = str;
     while (*src) {
@@ -76,246 +52,1770 @@ void sanitize_input(char *str) {
     *dst = '\0';
 }
 
-unsigned int hash_artist(const char *key) {
-    unsigned int hash = 0;
-    while (*key)
-        hash = (hash << 5) + tolower(*key++);
-    return hash % MAX_ARTIST_BUCKETS;
-}
-
-EmotionIndex *get_or_create_emotion(const char *emotion) {
+// Busca una emoción en una lista (la global o la de un índice parcial) o la crea
+static EmotionIndex *emotion_list_get(EmotionIndex **head, const char *emotion) {
     EmotionIndex *curr;
-    for (curr = emotion_index_head; curr; curr = curr->next)
+    for (curr = *head; curr; curr = curr->next)
         if (strcmp(curr->emotion, emotion) == 0)
             return curr;
 
-    EmotionIndex *new = malloc(sizeof(EmotionIndex));
+    EmotionIndex *new = calloc(1, sizeof(EmotionIndex));
+    if (!new) return NULL;
     strncpy(new->emotion, emotion, MAX_FIELD - 1);
     new->emotion[MAX_FIELD - 1] = '\0';
-    new->arousals = calloc(101, sizeof(ArousalIndex));
-    new->next = emotion_index_head;
-    emotion_index_head = new;
+    arena_init(&new->arena, 0);
+    new->arousals = arena_calloc(&new->arena, AROUSAL_LEVELS, sizeof(ArousalIndex));
+    if (!new->arousals) {
+        free(new);
+        return NULL;
+    }
+    new->next = *head;
+    *head = new;
     return new;
 }
 
-void add_position(const char *emotion, int arousal, const char *artist, long pos) {
-    if (arousal < 0 || arousal > 100) return;
+EmotionIndex *get_or_create_emotion(const char *emotion) {
+    return emotion_list_get(&emotion_index_head, emotion);
+}
+
+// Deja lugar para `extra` posiciones más, duplicando la capacidad. El arreglo viejo
+// queda en la arena, por eso conviene reservar de una vez todo lo que se va a agregar.
+static int posting_list_reserve(PostingList *list, Arena *arena, uint32_t extra) {
+    if (list->count + extra <= list->capacity) return 0;
+    uint32_t capacity = list->capacity ? list->capacity : 4;
+    while (capacity < list->count + extra) capacity *= 2;
+    int64_t *items = arena_alloc(arena, sizeof(int64_t) * capacity);
+    if (!items) return -1;
+    if (list->count) memcpy(items, list->items, sizeof(int64_t) * list->count);
+    list->items = items;
+    list->capacity = capacity;
+    return 0;
+}
+
+// Inserta una posición manteniendo el arreglo ordenado. Los hilos recorren el
+// CSV en orden, así que casi siempre es un append al final.
+static int posting_list_add(PostingList *list, Arena *arena, int64_t pos) {
+    if (posting_list_reserve(list, arena, 1) != 0) return -1;
+
+    uint32_t i = list->count;
+    while (i > 0 && list->items[i - 1] > pos) {
+        list->items[i] = list->items[i - 1];
+        i--;
+    }
+    list->items[i] = pos;
+    list->count++;
+    return 0;
+}
+
+// Agrega al final de `list` la mezcla de `count` listas ordenadas (una por parcial).
+// Todas son posteriores a lo que ya tiene la lista, que viene de chunks anteriores,
+// pero entre sí se intercalan porque los parsers se reparten los bloques del chunk.
+static int posting_list_merge(PostingList *list, Arena *arena, const PostingList *const *sources, int count) {
+    uint32_t total = 0;
+    for (int i = 0; i < count; i++) total += sources[i]->count;
+    if (posting_list_reserve(list, arena, total) != 0) return -1;
+
+    int64_t *out = list->items + list->count;
+    if (count == 1) {
+        memcpy(out, sources[0]->items, sizeof(int64_t) * total);
+    } else {
+        uint32_t next[MAX_INDEX_THREADS] = {0};
+        for (uint32_t k = 0; k < total; k++) {
+            int best = -1;
+            for (int i = 0; i < count; i++) {
+                if (next[i] == sources[i]->count) continue;
+                if (best < 0 || sources[i]->items[next[i]] < sources[best]->items[next[best]]) best = i;
+            }
+            out[k] = sources[best]->items[next[best]++];
+        }
+    }
+    list->count += total;
+    return 0;
+}
+
+// Distancia de la casilla `slot` a la casilla ideal de su artista
+static uint32_t arousal_slot_distance(const ArtistNode *slots, uint32_t mask, uint32_t slot) {
+    return (slot - (slots[slot].hash & mask)) & mask;
+}
+
+// Las tablas usan Robin Hood: un artista nuevo se queda con la casilla de uno que está
+// más cerca de su casilla ideal, que se corre un lugar junto con el resto del racimo.
+// Así los racimos quedan ordenados por casilla ideal y ningún artista termina lejos de
+// la suya aunque las inserciones lleguen agrupadas (como al copiar una tabla en orden).
+
+// Ocupa la casilla `slot` corriendo el racimo que empieza ahí hasta la primera libre.
+static void arousal_slots_open(ArtistNode *slots, uint32_t mask, uint32_t slot) {
+    uint32_t end = slot;
+    while (slots[end].artist_id != ARTIST_ID_NONE) end = (end + 1) & mask;
+    while (end != slot) {
+        uint32_t prev = (end - 1) & mask;
+        slots[end] = slots[prev];
+        end = prev;
+    }
+}
+
+// Busca `artist_id` (con hash `hash`) y devuelve su casilla o, si no está, la que le
+// toca (ya liberada). `*probes` cuenta las casillas visitadas.
+static uint32_t arousal_slots_find(ArtistNode *slots, uint32_t mask, uint32_t artist_id, uint32_t hash,
+                                   int *found, uint32_t *probes) {
+    uint32_t slot = hash & mask;
+    uint32_t distance = 0;
+    *found = 0;
+    while (slots[slot].artist_id != ARTIST_ID_NONE) {
+        if (slots[slot].artist_id == artist_id) {
+            *found = 1;
+            break;
+        }
+        if (arousal_slot_distance(slots, mask, slot) < distance) {
+            arousal_slots_open(slots, mask, slot);
+            break;
+        }
+        slot = (slot + 1) & mask;
+        distance++;
+    }
+    *probes = distance + 1;
+    return slot;
+}
+
+// Ubica un artista que seguro no está en la tabla (al crecer)
+static void arousal_slots_place(ArtistNode *slots, uint32_t mask, const ArtistNode *node) {
+    uint32_t slot = node->hash & mask;
+    uint32_t distance = 0;
+    while (slots[slot].artist_id != ARTIST_ID_NONE && arousal_slot_distance(slots, mask, slot) >= distance) {
+        slot = (slot + 1) & mask;
+        distance++;
+    }
+    if (slots[slot].artist_id != ARTIST_ID_NONE) arousal_slots_open(slots, mask, slot);
+    slots[slot] = *node;
+}
+
+static int arousal_index_grow(ArousalIndex *ai, Arena *arena) {
+    uint32_t slot_count = ai->slot_count ? ai->slot_count * 2 : HASH_MIN_SLOTS;
+    ArtistNode *slots = arena_alloc(arena, sizeof(ArtistNode) * slot_count);
+    if (!slots) return -1;
+    for (uint32_t i = 0; i < slot_count; i++) slots[i].artist_id = ARTIST_ID_NONE;
+
+    uint32_t mask = slot_count - 1;
+    for (uint32_t i = 0; i < ai->slot_count; i++)
+        if (ai->slots[i].artist_id != ARTIST_ID_NONE) arousal_slots_place(slots, mask, &ai->slots[i]);
+
+    ai->slots = slots;
+    ai->slot_count = slot_count;
+    return 0;
+}
+
+// Devuelve la casilla del artista en el arousal, creándola si no existe. La casilla
+// vale hasta la próxima inserción en la tabla, que puede correrla.
+static ArtistNode *arousal_index_get(ArousalIndex *ai, Arena *arena, uint32_t artist_id, HashProbeStats *stats) {
+    if ((uint64_t)(ai->count + 1) * HASH_MAX_LOAD_DEN > (uint64_t)ai->slot_count * HASH_MAX_LOAD_NUM &&
+        arousal_index_grow(ai, arena) != 0)
+        return NULL;
+
+    int found;
+    uint32_t probes;
+    uint32_t hash = artist_id_hash(artist_id);
+    uint32_t slot = arousal_slots_find(ai->slots, ai->slot_count - 1, artist_id, hash, &found, &probes);
+    if (!found) {
+        ai->slots[slot].artist_id = artist_id;
+        ai->slots[slot].hash = hash;
+        memset(&ai->slots[slot].positions, 0, sizeof(PostingList));
+        ai->count++;
+    }
+    if (stats) hash_probe_record(stats, probes);
+    return &ai->slots[slot];
+}
+
+// Acumula la distancia de cada artista a su casilla ideal (sondeo de una búsqueda exitosa)
+static void arousal_placement_stats(const ArousalIndex *ai, HashProbeStats *stats) {
+    uint32_t mask = ai->slot_count - 1;
+    for (uint32_t s = 0; s < ai->slot_count; s++)
+        if (ai->slots[s].artist_id != ARTIST_ID_NONE)
+            hash_probe_record(stats, arousal_slot_distance(ai->slots, mask, s) + 1);
+}
+
+int add_position(const char *emotion, int arousal, const char *artist, long pos) {
+    if (arousal < 0 || arousal > 100) return 0;
 
     pthread_mutex_lock(&index_mutex);
-    EmotionIndex *eidx = get_or_create_emotion(emotion);
-    ArousalIndex *ai = &eidx->arousals[arousal];
-    unsigned int idx = hash_artist(artist);
-
-    ArtistNode *curr = ai->buckets[idx];
-    while (curr && strcmp(curr->artist, artist) != 0)
-        curr = curr->next;
-
-    if (!curr) {
-        curr = malloc(sizeof(ArtistNode));
-        strncpy(curr->artist, artist, MAX_FIELD - 1);
-        curr->artist[MAX_FIELD - 1] = '\0';
-        curr->positions = NULL;
-        curr->next = ai->buckets[idx];
-        ai->buckets[idx] = curr;
-    }
-
-    PosNode *p = malloc(sizeof(PosNode));
-    p->pos = pos;
-    p->next = curr->positions;
-    curr->positions = p;
+    int rc = -1;
+    uint32_t artist_id = artist_dict_intern(&artist_dict, artist);
+    EmotionIndex *eidx = artist_id != ARTIST_ID_NONE ? get_or_create_emotion(emotion) : NULL;
+    ArtistNode *curr = eidx ? arousal_index_get(&eidx->arousals[arousal], &eidx->arena, artist_id,
+                                                &arousal_probe_stats) : NULL;
+    if (curr) rc = posting_list_add(&curr->positions, &eidx->arena, pos);
     pthread_mutex_unlock(&index_mutex);
+    return rc;
 }
 
-void save_index_to_disk() {
-    mkdir(INDEX_FOLDER, 0775);
-    for (EmotionIndex *curr = emotion_index_head; curr; curr = curr->next) {
-        char path[256];
-        snprintf(path, sizeof(path), "%sindex_%s.bin", INDEX_FOLDER, curr->emotion);
-        FILE *f = fopen(path, "wb");
-        if (!f) {
-            perror("fopen");
-            continue;
+// Igual que add_position pero sobre el índice parcial de un hilo: no toma ningún lock.
+// Si falta memoria marca el parcial, y la mezcla aborta la indexación.
+static void partial_add_position(PartialIndex *partial, const char *emotion, int arousal, const char *artist,
+                                 long pos) {
+    if (arousal < 0 || arousal > 100 || partial->failed) return;
+
+    uint32_t local_id = artist_dict_intern(&partial->artists, artist);
+    EmotionIndex *eidx = local_id != ARTIST_ID_NONE ? emotion_list_get(&partial->emotions, emotion) : NULL;
+    ArtistNode *curr = eidx ? arousal_index_get(&eidx->arousals[arousal], &eidx->arena, local_id, NULL) : NULL;
+    if (!curr || posting_list_add(&curr->positions, &eidx->arena, pos) != 0) partial->failed = 1;
+}
+
+static void free_partial_index(PartialIndex *partial) {
+    EmotionIndex *curr = partial->emotions;
+    while (curr) {
+        EmotionIndex *next = curr->next;
+        free_emotion_index(curr);
+        curr = next;
+    }
+    artist_dict_reset(&partial->artists);
+    free(partial->global_ids);
+    memset(partial, 0, sizeof(*partial));
+}
+
+// Una emoción del índice global junto con sus partes en cada índice parcial
+typedef struct {
+    EmotionIndex *target;
+    EmotionIndex *parts[MAX_INDEX_THREADS];
+} MergeTask;
+
+typedef struct {
+    MergeTask *tasks;
+    int count;
+    int next;                   // Siguiente tarea libre (protegido por lock)
+    PartialIndex *partials;
+    HashProbeStats stats;       // Sondeos de todos los hilos (protegido por lock)
+    int failed;                 // Alguna emoción quedó incompleta por falta de memoria (protegido por lock)
+    pthread_mutex_t lock;
+} MergeQueue;
+
+// Lista de un artista en un parcial, ya con su id global
+typedef struct {
+    uint32_t global_id;
+    const PostingList *positions;
+} MergeRef;
+
+static int compare_merge_refs(const void *a, const void *b) {
+    const MergeRef *x = a, *y = b;
+    return (x->global_id > y->global_id) - (x->global_id < y->global_id);
+}
+
+// Cada hilo toma emociones completas: ninguna arena ni tabla se comparte entre hilos
+static void *merge_worker(void *arg) {
+    MergeQueue *queue = arg;
+    HashProbeStats stats = {0};
+    MergeRef *refs = NULL;
+    uint32_t refs_capacity = 0;
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        int t = queue->next < queue->count && !queue->failed ? queue->next++ : -1;
+        pthread_mutex_unlock(&queue->lock);
+        if (t < 0) break;
+
+        EmotionIndex *target = queue->tasks[t].target;
+        int failed = 0;
+        for (int a = 0; a < AROUSAL_LEVELS && !failed; a++) {
+            uint32_t needed = 0;
+            for (int w = 0; w < index_threads; w++)
+                if (queue->tasks[t].parts[w]) needed += queue->tasks[t].parts[w]->arousals[a].count;
+            if (needed == 0) continue;
+            if (needed > refs_capacity) {
+                MergeRef *grown = realloc(refs, sizeof(MergeRef) * needed);
+                if (!grown) {
+                    perror("realloc");
+                    failed = 1;
+                    break;
+                }
+                refs = grown;
+                refs_capacity = needed;
+            }
+
+            // Se juntan las listas de todos los parciales y se agrupan por artista:
+            // cada lista global crece una sola vez por chunk
+            uint32_t n = 0;
+            for (int w = 0; w < index_threads; w++) {
+                const EmotionIndex *part = queue->tasks[t].parts[w];
+                if (!part) continue;
+                const uint32_t *global_ids = queue->partials[w].global_ids;
+                const ArousalIndex *ai = &part->arousals[a];
+                for (uint32_t s = 0; s < ai->slot_count; s++) {
+                    const ArtistNode *node = &ai->slots[s];
+                    if (node->artist_id == ARTIST_ID_NONE) continue;
+                    refs[n].global_id = global_ids[node->artist_id];
+                    refs[n].positions = &node->positions;
+                    n++;
+                }
+            }
+            qsort(refs, n, sizeof(MergeRef), compare_merge_refs);
+
+            for (uint32_t i = 0; i < n && !failed;) {
+                const PostingList *sources[MAX_INDEX_THREADS];
+                int count = 0;
+                uint32_t global_id = refs[i].global_id;
+                for (; i < n && refs[i].global_id == global_id; i++) sources[count++] = refs[i].positions;
+                ArtistNode *dest = arousal_index_get(&target->arousals[a], &target->arena, global_id, &stats);
+                failed = !dest || posting_list_merge(&dest->positions, &target->arena, sources, count) != 0;
+            }
         }
+        if (failed) {
+            fprintf(stderr, "[indexador] Sin memoria al mezclar la emoción '%s'\n", target->emotion);
+            pthread_mutex_lock(&queue->lock);
+            queue->failed = 1;
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+    free(refs);
 
-        for (int i = 0; i <= 100; i++) {
-            ArousalIndex *ai = &curr->arousals[i];
-            int bucket_count = 0;
-            long pos = ftell(f);
-            fwrite(&bucket_count, sizeof(int), 1, f); // Placeholder
-
-            for (int b = 0; b < MAX_ARTIST_BUCKETS; b++) {
-                for (ArtistNode *an = ai->buckets[b]; an; an = an->next) {
-                    int len = strlen(an->artist);
-                    fwrite(&len, sizeof(int), 1, f);
-                    fwrite(an->artist, sizeof(char), len, f);
-
-                    int count = 0;
-                    for (PosNode *pn = an->positions; pn; pn = pn->next) count++;
-                    fwrite(&count, sizeof(int), 1, f);
-                    for (PosNode *pn = an->positions; pn; pn = pn->next)
-                        fwrite(&pn->pos, sizeof(long), 1, f);
-
-                    bucket_count++;
+    pthread_mutex_lock(&queue->lock);
+    queue->stats.lookups += stats.lookups;
+    queue->stats.probes += stats.probes;
+    if (stats.max_probe > queue->stats.max_probe) queue->stats.max_probe = stats.max_probe;
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+// Fase de mezcla: traduce los ids locales a globales y vuelca las emociones en paralelo.
+// Devuelve -1 si faltó memoria: el índice global quedó incompleto y no debe escribirse.
+static int merge_partial_indexes(PartialIndex *partials) {
+    for (int w = 0; w < index_threads; w++) {
+        PartialIndex *partial = &partials[w];
+        partial->global_ids = malloc(sizeof(uint32_t) * (partial->artists.count ? partial->artists.count : 1));
+        if (!partial->global_ids) {
+            perror("malloc");
+            return -1;
+        }
+        for (uint32_t l = 0; l < partial->artists.count; l++) {
+            partial->global_ids[l] = artist_dict_intern(&artist_dict, partial->artists.names[l]);
+            if (partial->global_ids[l] == ARTIST_ID_NONE) {
+                fprintf(stderr, "[indexador] No se pudo agregar el artista '%s' al diccionario\n",
+                        partial->artists.names[l]);
+                return -1;
+            }
+        }
+    }
+
+    MergeQueue queue = { .partials = partials, .lock = PTHREAD_MUTEX_INITIALIZER };
+    int capacity = 0;
+    for (int w = 0; w < index_threads; w++) {
+        for (EmotionIndex *part = partials[w].emotions; part; part = part->next) {
+            EmotionIndex *target = get_or_create_emotion(part->emotion);
+            if (!target) {
+                perror("malloc");
+                free(queue.tasks);
+                return -1;
+            }
+
+            int t = 0;
+            while (t < queue.count && queue.tasks[t].target != target) t++;
+            if (t == queue.count) {
+                if (queue.count == capacity) {
+                    capacity = capacity ? capacity * 2 : 64;
+                    MergeTask *grown = realloc(queue.tasks, sizeof(MergeTask) * capacity);
+                    if (!grown) {
+                        perror("realloc");
+                        free(queue.tasks);
+                        return -1;
+                    }
+                    queue.tasks = grown;
                 }
+                memset(&queue.tasks[queue.count], 0, sizeof(MergeTask));
+                queue.tasks[queue.count++].target = target;
             }
+            queue.tasks[t].parts[w] = part;
+        }
+    }
+
+    pthread_t threads[MAX_INDEX_THREADS];
+    int started = 0;
+    for (int i = 0; i < index_threads && i < queue.count; i++)
+        if (pthread_create(&threads[started], NULL, merge_worker, &queue) == 0) started++;
+    if (started == 0) merge_worker(&queue);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
 
-            long current = ftell(f);
-            fseek(f, pos, SEEK_SET);
-            fwrite(&bucket_count, sizeof(int), 1, f);
-            fseek(f, current, SEEK_SET);
+    arousal_probe_stats.lookups += queue.stats.lookups;
+    arousal_probe_stats.probes += queue.stats.probes;
+    if (queue.stats.max_probe > arousal_probe_stats.max_probe) arousal_probe_stats.max_probe = queue.stats.max_probe;
+    free(queue.tasks);
+    return queue.failed ? -1 : 0;
+}
+
+void free_emotion_index(EmotionIndex *eidx) {
+    while (eidx) {
+        EmotionIndex *next = eidx->next_segment;
+        unmap_emotion_index(eidx);
+        arena_release(&eidx->arena);
+        free(eidx);
+        eidx = next;
+    }
+}
+
+// Libera las emociones en memoria conservando el diccionario de artistas
+static void release_emotions(void) {
+    EmotionIndex *curr = emotion_index_head;
+    while (curr) {
+        EmotionIndex *next = curr->next;
+        free_emotion_index(curr);
+        curr = next;
+    }
+    emotion_index_head = NULL;
+}
+
+void clear_index(void) {
+    release_emotions();
+    artist_dict_reset(&artist_dict);
+    memset(&arousal_probe_stats, 0, sizeof(arousal_probe_stats));
+    spilled_entries = spilled_slots = 0;
+    memset(&spilled_placement, 0, sizeof(spilled_placement));
+    peak_arena_bytes = 0;
+}
+
+void report_arena_usage(void) {
+    size_t reserved = 0, used = 0, blocks = 0, largest = 0;
+    const char *largest_emotion = "-";
+    int emotions = 0;
+    for (EmotionIndex *curr = emotion_index_head; curr; curr = curr->next) {
+        reserved += curr->arena.reserved;
+        used += curr->arena.used;
+        blocks += curr->arena.blocks;
+        if (curr->arena.reserved > largest) {
+            largest = curr->arena.reserved;
+            largest_emotion = curr->emotion;
         }
+        emotions++;
+    }
+    if (reserved > peak_arena_bytes) peak_arena_bytes = reserved;
+    printf("[indexador] Arenas: %d emociones, %zu bloques, %.1f MB reservados, %.1f MB usados "
+           "(mayor: '%s' con %.1f MB, pico: %.1f MB)\n",
+           emotions, blocks, reserved / 1048576.0, used / 1048576.0,
+           largest_emotion, largest / 1048576.0, peak_arena_bytes / 1048576.0);
+    printf("[indexador] Diccionario de artistas: %u artistas, %.1f MB\n",
+           artist_dict.count, artist_dict.arena.reserved / 1048576.0);
+}
 
-        fclose(f);
-        
+int report_hash_stats(void) {
+    uint64_t entries = spilled_entries, slots = spilled_slots;
+    HashProbeStats placement = spilled_placement;
+    for (EmotionIndex *curr = emotion_index_head; curr; curr = curr->next) {
+        for (int i = 0; i < AROUSAL_LEVELS; i++) {
+            entries += curr->arousals[i].count;
+            slots += curr->arousals[i].slot_count;
+            arousal_placement_stats(&curr->arousals[i], &placement);
+        }
     }
-    printf("[indexador] Índice guardado.\n");
+    hash_probe_report("Artistas por arousal", &arousal_probe_stats, entries, slots);
+    hash_probe_report("Artistas por arousal (ubicación final)", &placement, entries, slots);
+    hash_probe_report("Diccionario de artistas", &artist_dict.stats, artist_dict.count, artist_dict.slot_count);
+
+    // Las búsquedas durante la construcción incluyen tablas al 3/4 y artistas nuevos;
+    // lo que se controla es cómo quedaron las tablas
+    HashProbeStats dict_placement;
+    artist_dict_probe_stats(&artist_dict, &dict_placement);
+    int rc = hash_probe_check("Artistas por arousal", &placement);
+    if (hash_probe_check("Diccionario de artistas", &dict_placement) != 0) rc = -1;
+    return rc;
 }
 
-void *process_lines(void *arg) {
-    ThreadArgs *args = (ThreadArgs *)arg;
-    for (long i = 0; i < args->num_lines; i++) {
-        char *line = args->lines[i];
-        long pos = args->positions[i];
-
-        char *tokens[NUM_FIELDS];
-        char *p = line;
-        for (int j = 0; j < NUM_FIELDS; j++) {
-            char *start = p;
-            while (*p && *p != ',') {
-                if (*p == '[') while (*p && *p != ']') p++;
-                if (*p) p++;
-            }
-            if (*p) *p++ = '\0';
-            tokens[j] = start;
+static int compare_artist_nodes(const void *a, const void *b) {
+    const ArtistNode *x = *(const ArtistNode *const *)a;
+    const ArtistNode *y = *(const ArtistNode *const *)b;
+    return (x->artist_id > y->artist_id) - (x->artist_id < y->artist_id);
+}
+
+static void init_index_header(IndexFileHeader *hdr, uint64_t artist_count, uint64_t position_count,
+                              uint64_t postings_size) {
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    hdr->version = INDEX_VERSION;
+    hdr->arousal_levels = AROUSAL_LEVELS;
+    hdr->artist_count = artist_count;
+    hdr->position_count = position_count;
+    hdr->artists_offset = sizeof(IndexFileHeader) + sizeof(IndexArousalEntry) * AROUSAL_LEVELS;
+    hdr->postings_offset = hdr->artists_offset + sizeof(IndexArtistEntry) * artist_count;
+    hdr->postings_size = postings_size;
+    hdr->file_size = hdr->postings_offset + postings_size;
+    hdr->dictionary_id = artist_dict.dictionary_id;
+}
+
+// Escribe `size` bytes en `path` con write(2) directo (sin stdio). Se escribe aparte
+// y se renombra: un servidor con el archivo mapeado nunca lo ve a medias.
+static int write_file_atomic(const char *path, const void *data, size_t size) {
+    char tmp_path[PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    if (fd < 0) {
+        perror("open");
+        return -1;
+    }
+    int rc = 0;
+    const char *p = data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            perror("write");
+            rc = -1;
+            break;
         }
+        p += n;
+        size -= (size_t)n;
+    }
+    if (close(fd) != 0) rc = -1;
+    if (rc == 0 && rename(tmp_path, path) != 0) {
+        perror("rename");
+        rc = -1;
+    }
+    if (rc != 0) unlink(tmp_path);
+    return rc;
+}
 
-        char artist[MAX_FIELD] = "";
-        if (tokens[2]) {
-            strncpy(artist, tokens[2], MAX_FIELD - 1);
-            artist[MAX_FIELD - 1] = '\0';
-            sanitize_input(artist);
+// Escribe una emoción con el formato descrito en indexador.h.
+// Primero se ordenan los artistas y se codifican todas las listas en memoria
+// para conocer los offsets; luego se escribe el archivo completo de una vez.
+static int write_emotion_file(const EmotionIndex *eidx, const char *path) {
+    uint64_t artist_count = 0, position_count = 0, postings_bound = 0;
+    for (int i = 0; i < AROUSAL_LEVELS; i++) {
+        const ArousalIndex *ai = &eidx->arousals[i];
+        artist_count += ai->count;
+        for (uint32_t s = 0; s < ai->slot_count; s++) {
+            if (ai->slots[s].artist_id == ARTIST_ID_NONE) continue;
+            position_count += ai->slots[s].positions.count;
+            postings_bound += posting_encoded_bound(ai->slots[s].positions.count);
         }
+    }
 
-        if (tokens[3]) {
-            char seeds_raw[MAX_FIELD];
-            strncpy(seeds_raw, tokens[3], MAX_FIELD - 1);
-            seeds_raw[MAX_FIELD - 1] = '\0';
-            char *q = seeds_raw;
-
-            while ((q = strchr(q, '\'')) != NULL) {
-                q++;
-                char *end = strchr(q, '\'');
-                if (!end) break;
-                *end = '\0';
-
-                char emotion_clean[MAX_FIELD];
-                strncpy(emotion_clean, q, MAX_FIELD - 1);
-                emotion_clean[MAX_FIELD - 1] = '\0';
-                sanitize_input(emotion_clean);
-
-                if (strlen(emotion_clean) > 0) {
-                    int arousal = (int) atof(tokens[6]);
-                    add_position(emotion_clean, arousal, artist, pos);
+    IndexFileHeader hdr;
+    init_index_header(&hdr, artist_count, position_count, 0);
+    const ArtistNode **sorted = malloc(sizeof(ArtistNode *) * (artist_count ? artist_count : 1));
+    uint8_t *buffer = malloc(hdr.postings_offset + postings_bound);
+    if (!sorted || !buffer) {
+        perror("malloc");
+        free(sorted); free(buffer);
+        return -1;
+    }
+    IndexArousalEntry *dirs = (IndexArousalEntry *)(buffer + sizeof(IndexFileHeader));
+    IndexArtistEntry *entries = (IndexArtistEntry *)(buffer + hdr.artists_offset);
+    uint8_t *postings = buffer + hdr.postings_offset;
+
+    // Directorio de arousal y orden de los artistas (por id) de cada nivel
+    uint64_t ordered = 0;
+    for (int i = 0; i < AROUSAL_LEVELS; i++) {
+        const ArousalIndex *ai = &eidx->arousals[i];
+        dirs[i].first_artist = (uint32_t)ordered;
+        dirs[i].artist_count = 0;
+        for (uint32_t s = 0; s < ai->slot_count; s++)
+            if (ai->slots[s].artist_id != ARTIST_ID_NONE)
+                sorted[ordered + dirs[i].artist_count++] = &ai->slots[s];
+        qsort(&sorted[ordered], dirs[i].artist_count, sizeof(ArtistNode *), compare_artist_nodes);
+        ordered += dirs[i].artist_count;
+    }
+
+    uint64_t postings_size = 0;
+    for (uint64_t j = 0; j < artist_count; j++) {
+        IndexArtistEntry *entry = &entries[j];
+        memset(entry, 0, sizeof(*entry));
+        entry->artist_id = sorted[j]->artist_id;
+        entry->position_count = sorted[j]->positions.count;
+        entry->data_offset = (uint32_t)postings_size;
+        entry->data_size = (uint32_t)posting_encode(sorted[j]->positions.items, sorted[j]->positions.count,
+                                                    postings + postings_size);
+        postings_size += entry->data_size;
+    }
+    free(sorted);
+
+    // Los offsets de las listas son de 32 bits: una emoción no puede pasar de 4 GB comprimida
+    if (postings_size > UINT32_MAX) {
+        fprintf(stderr, "[indexador] Las posiciones de '%s' no caben en el formato del índice\n", eidx->emotion);
+        free(buffer);
+        return -1;
+    }
+
+    init_index_header(&hdr, artist_count, position_count, postings_size);
+    memcpy(buffer, &hdr, sizeof(hdr));
+    int rc = write_file_atomic(path, buffer, hdr.file_size);
+    free(buffer);
+    return rc;
+}
+
+// Entrada actual de un run en un arousal, o NULL si ya se recorrió completo
+static const IndexArtistEntry *run_entry(const EmotionIndex *run, int arousal, uint32_t cursor) {
+    const IndexArousalEntry *dir = &run->arousal_dir[arousal];
+    return cursor < dir->artist_count ? &run->artist_table[dir->first_artist + cursor] : NULL;
+}
+
+// Menor id de artista pendiente entre todos los runs, o ARTIST_ID_NONE
+static uint32_t min_run_artist(const EmotionIndex *const *runs, int nruns, int arousal, const uint32_t *cursor) {
+    uint32_t min = ARTIST_ID_NONE;
+    for (int r = 0; r < nruns; r++) {
+        const IndexArtistEntry *entry = run_entry(runs[r], arousal, cursor[r]);
+        if (entry && entry->artist_id < min) min = entry->artist_id;
+    }
+    return min;
+}
+
+// Mezcla k runs mapeados (que cubren rangos crecientes del CSV) en un solo archivo.
+// Cada arousal se recorre como un merge de k vías sobre las tablas ordenadas por id;
+// la lista de un artista es la concatenación de sus listas en orden de run, así que
+// en memoria solo hay una lista a la vez.
+static int merge_index_runs(const EmotionIndex *const *runs, int nruns, const char *path) {
+    for (int r = 0; r < nruns; r++)
+        for (int a = 0; a < AROUSAL_LEVELS; a++)
+            if ((uint64_t)runs[r]->arousal_dir[a].first_artist + runs[r]->arousal_dir[a].artist_count >
+                runs[r]->header->artist_count) {
+                fprintf(stderr, "[indexador] Directorio de arousal inválido en un run de '%s'\n", path);
+                return -1;
+            }
+
+    uint32_t *cursor = calloc(nruns ? nruns : 1, sizeof(uint32_t));
+    IndexArousalEntry *dirs = calloc(AROUSAL_LEVELS, sizeof(IndexArousalEntry));
+    if (!cursor || !dirs) {
+        perror("malloc");
+        free(cursor); free(dirs);
+        return -1;
+    }
+
+    // Primera pasada: artistas distintos por arousal, para saber dónde empiezan las posiciones
+    uint64_t artist_count = 0, position_count = 0;
+    for (int a = 0; a < AROUSAL_LEVELS; a++) {
+        dirs[a].first_artist = (uint32_t)artist_count;
+        memset(cursor, 0, sizeof(uint32_t) * nruns);
+        uint32_t id;
+        while ((id = min_run_artist(runs, nruns, a, cursor)) != ARTIST_ID_NONE) {
+            for (int r = 0; r < nruns; r++) {
+                const IndexArtistEntry *entry = run_entry(runs[r], a, cursor[r]);
+                if (entry && entry->artist_id == id) {
+                    position_count += entry->position_count;
+                    cursor[r]++;
                 }
+            }
+            dirs[a].artist_count++;
+        }
+        artist_count += dirs[a].artist_count;
+    }
 
-                q = end + 1;
+    IndexFileHeader hdr;
+    init_index_header(&hdr, artist_count, position_count, 0);
+    IndexArtistEntry *entries = calloc(artist_count ? artist_count : 1, sizeof(IndexArtistEntry));
+
+    char tmp_path[PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *f = entries ? fopen(tmp_path, "wb") : NULL;
+    if (!f) {
+        perror(entries ? "fopen" : "malloc");
+        free(cursor); free(dirs); free(entries);
+        return -1;
+    }
+    // Las listas se escriben una por artista: un buffer grande evita un write(2) por cada una
+    setvbuf(f, NULL, _IOFBF, INDEX_WRITE_BUFFER_BYTES);
+
+    // Segunda pasada: las posiciones se escriben directo en su sección del archivo
+    int64_t *positions = NULL;
+    uint8_t *encoded = NULL;
+    uint64_t capacity = 0, postings_size = 0, j = 0;
+    int rc = fseek(f, (long)hdr.postings_offset, SEEK_SET) == 0 ? 0 : -1;
+    for (int a = 0; a < AROUSAL_LEVELS && rc == 0; a++) {
+        memset(cursor, 0, sizeof(uint32_t) * nruns);
+        uint32_t id;
+        while (rc == 0 && (id = min_run_artist(runs, nruns, a, cursor)) != ARTIST_ID_NONE) {
+            uint64_t total = 0;
+            for (int r = 0; r < nruns; r++) {
+                const IndexArtistEntry *entry = run_entry(runs[r], a, cursor[r]);
+                if (entry && entry->artist_id == id) total += entry->position_count;
+            }
+            if (total > UINT32_MAX) {
+                rc = -1;
+                break;
+            }
+            if (total > capacity) {
+                int64_t *grown_positions = realloc(positions, sizeof(int64_t) * total);
+                if (grown_positions) positions = grown_positions;
+                uint8_t *grown_encoded = realloc(encoded, posting_encoded_bound((uint32_t)total));
+                if (grown_encoded) encoded = grown_encoded;
+                if (!grown_positions || !grown_encoded) {
+                    perror("realloc");
+                    rc = -1;
+                    break;
+                }
+                capacity = total;
             }
+
+            uint64_t filled = 0;
+            for (int r = 0; r < nruns && rc == 0; r++) {
+                const IndexArtistEntry *entry = run_entry(runs[r], a, cursor[r]);
+                if (!entry || entry->artist_id != id) continue;
+                if (decode_positions(runs[r], entry, positions + filled) != 0) rc = -1;
+                filled += entry->position_count;
+                cursor[r]++;
+            }
+            if (rc != 0) break;
+
+            size_t size = posting_encode(positions, (uint32_t)total, encoded);
+            if (postings_size + size > UINT32_MAX || fwrite(encoded, 1, size, f) != size) {
+                fprintf(stderr, "[indexador] Las posiciones de '%s' no caben en el formato del índice\n", path);
+                rc = -1;
+                break;
+            }
+            entries[j].artist_id = id;
+            entries[j].position_count = (uint32_t)total;
+            entries[j].data_offset = (uint32_t)postings_size;
+            entries[j].data_size = (uint32_t)size;
+            postings_size += size;
+            j++;
         }
     }
 
+    if (rc == 0) {
+        init_index_header(&hdr, artist_count, position_count, postings_size);
+        if (fseek(f, 0, SEEK_SET) != 0 ||
+            fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+            fwrite(dirs, sizeof(IndexArousalEntry), AROUSAL_LEVELS, f) != AROUSAL_LEVELS ||
+            fwrite(entries, sizeof(IndexArtistEntry), artist_count, f) != artist_count)
+            rc = -1;
+    }
+    if (fclose(f) != 0) rc = -1;
+    if (rc == 0 && rename(tmp_path, path) != 0) {
+        perror("rename");
+        rc = -1;
+    }
+    if (rc != 0) unlink(tmp_path);
+
+    free(positions);
+    free(encoded);
+    free(cursor);
+    free(dirs);
+    free(entries);
+    return rc;
+}
+
+// Escritura de emociones en paralelo: cada hilo toma la siguiente emoción libre
+// y la escribe completa, así que ningún archivo se comparte entre hilos
+typedef struct {
+    int (*write)(void *ctx, int index);
+    void *ctx;
+    int count;
+    int next;                   // Siguiente emoción libre (protegido por lock)
+    int failed;                 // Emociones que no se pudieron escribir (protegido por lock)
+    pthread_mutex_t lock;
+} WriteQueue;
+
+static void *write_worker(void *arg) {
+    WriteQueue *queue = arg;
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        int i = queue->next < queue->count ? queue->next++ : -1;
+        pthread_mutex_unlock(&queue->lock);
+        if (i < 0) break;
+
+        if (queue->write(queue->ctx, i) != 0) {
+            pthread_mutex_lock(&queue->lock);
+            queue->failed++;
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
     return NULL;
 }
 
-// ------------- INDEXADOR PRINCIPAL -------------
+// Llama a write(ctx, i) para i = 0..count-1 con hasta index_threads hilos.
+// Devuelve la cantidad de llamadas que fallaron.
+static int write_in_parallel(int count, int (*write)(void *ctx, int index), void *ctx) {
+    WriteQueue queue = { .write = write, .ctx = ctx, .count = count, .lock = PTHREAD_MUTEX_INITIALIZER };
+    pthread_t threads[MAX_INDEX_THREADS];
+    int started = 0;
+    for (int i = 0; i < index_threads && i < count; i++)
+        if (pthread_create(&threads[started], NULL, write_worker, &queue) == 0) started++;
+    if (started == 0) write_worker(&queue);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    return queue.failed;
+}
 
-void buildIndex(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        perror("Error abriendo CSV");
-        exit(1);
+// Emociones del índice global como arreglo, para repartirlas entre los hilos de escritura
+static EmotionIndex **emotion_array(int *count) {
+    *count = 0;
+    for (EmotionIndex *curr = emotion_index_head; curr; curr = curr->next) (*count)++;
+    EmotionIndex **emotions = malloc(sizeof(EmotionIndex *) * (*count ? *count : 1));
+    if (!emotions) {
+        perror("malloc");
+        return NULL;
     }
+    int i = 0;
+    for (EmotionIndex *curr = emotion_index_head; curr; curr = curr->next) emotions[i++] = curr;
+    return emotions;
+}
 
-    char header[LINE_BUFFER];
-    if(!fgets(header, sizeof(header), file)){
-        perror("Error leyendo el header del CSV");
-        fclose(file);
-        exit(1);
-    } // Skip header
+// Emociones a escribir y número de segmento (o de run) de los archivos
+typedef struct {
+    EmotionIndex **emotions;
+    uint32_t number;
+} EmotionWriteJob;
 
-    char **lines = malloc(sizeof(char *) * CHUNK_SIZE);
-    long *positions = malloc(sizeof(long) * CHUNK_SIZE);
-    long total = 0;
+static int write_segment_emotion(void *ctx, int index) {
+    EmotionWriteJob *job = ctx;
+    char path[PATH_MAX];
+    index_segment_path(path, sizeof(path), job->emotions[index]->emotion, job->number);
+    return write_emotion_file(job->emotions[index], path);
+}
 
-    long chunk_id = 0;
-    long count = 0;
-    char line[LINE_BUFFER];
+void index_segment_path(char *buf, size_t size, const char *emotion, uint32_t segment) {
+    if (segment == 0) snprintf(buf, size, "%sindex_%s.bin", index_folder, emotion);
+    else snprintf(buf, size, "%sindex_%s.%u.bin", index_folder, emotion, segment);
+}
 
-    while (1) {
-        long pos = ftell(file);
-        if (!fgets(line, sizeof(line), file)) break;
+int parse_index_file_name(const char *name, char *emotion, uint32_t *segment) {
+    size_t len = strlen(name);
+    if (strncmp(name, "index_", 6) != 0 || len < 11 || strcmp(name + len - 4, ".bin") != 0)
+        return -1;
 
-        lines[count] = strdup(line);
-        positions[count] = pos;
-        count++;
-        total++;
+    // Las emociones están sanitizadas (solo letras): un punto separa el número de segmento
+    size_t emotion_len = len - 10;
+    const char *dot = memchr(name + 6, '.', emotion_len);
+    *segment = 0;
+    if (dot) {
+        char *end;
+        unsigned long k = strtoul(dot + 1, &end, 10);
+        if (end != name + len - 4 || k == 0 || k > UINT32_MAX) return -1;
+        *segment = (uint32_t)k;
+        emotion_len = dot - (name + 6);
+    }
+    if (emotion_len == 0 || emotion_len >= MAX_FIELD) return -1;
+    memcpy(emotion, name + 6, emotion_len);
+    emotion[emotion_len] = '\0';
+    return 0;
+}
 
+// Crea la carpeta de índices y las carpetas que le falten en la ruta
+static void make_index_folder(void) {
+    char path[sizeof(index_folder)];
+    snprintf(path, sizeof(path), "%s", index_folder);
+    for (char *slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        mkdir(path, 0775);
+        *slash = '/';
+    }
+}
 
-        if (count >= CHUNK_SIZE) {
-            printf("[indexador] Procesando chunk %ld...\n", ++chunk_id);
+int save_index_segment(uint32_t segment) {
+    make_index_folder();
 
-            pthread_t threads[NUM_THREADS];
-            ThreadArgs args[NUM_THREADS];
-            long chunk_per_thread = count / NUM_THREADS;
+    // El diccionario se escribe primero: los índices por emoción refieren sus ids
+    char dict_path[PATH_MAX];
+    snprintf(dict_path, sizeof(dict_path), "%s%s", index_folder, ARTIST_DICT_FILE);
+    if (artist_dict_save(&artist_dict, dict_path) != 0) {
+        fprintf(stderr, "[indexador] No se pudo guardar el diccionario de artistas\n");
+        return -1;
+    }
 
-            for (int i = 0; i < NUM_THREADS; i++) {
-                args[i].id = i;
-                args[i].lines = &lines[i * chunk_per_thread];
-                args[i].positions = &positions[i * chunk_per_thread];
-                args[i].num_lines = (i == NUM_THREADS - 1) ? (count - i * chunk_per_thread) : chunk_per_thread;
-            }
+    int count;
+    EmotionWriteJob job = { .emotions = emotion_array(&count), .number = segment };
+    if (!job.emotions) return -1;
+    int failed = write_in_parallel(count, write_segment_emotion, &job);
+    free(job.emotions);
+    if (failed) {
+        fprintf(stderr, "[indexador] No se pudieron escribir %d emociones\n", failed);
+        return -1;
+    }
+    if (segment == 0) printf("[indexador] Índice guardado.\n");
+    else printf("[indexador] Segmento %u guardado.\n", segment);
+    return 0;
+}
+
+void save_index_to_disk() {
+    save_index_segment(0);
+}
+
+int read_index_manifest(IndexManifest *manifest) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s%s", index_folder, INDEX_MANIFEST_FILE);
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    int ok = fread(manifest, sizeof(*manifest), 1, f) == 1 &&
+             memcmp(manifest->magic, INDEX_MANIFEST_MAGIC, sizeof(INDEX_MANIFEST_MAGIC)) == 0 &&
+             manifest->version == INDEX_MANIFEST_VERSION;
+    fclose(f);
+    if (!ok) fprintf(stderr, "[indexador] Manifest inválido o desactualizado: %s\n", path);
+    return ok ? 0 : -1;
+}
+
+int write_index_manifest(const IndexManifest *manifest) {
+    char path[PATH_MAX], tmp_path[PATH_MAX + 8];
+    snprintf(path, sizeof(path), "%s%s", index_folder, INDEX_MANIFEST_FILE);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    IndexManifest out = *manifest;
+    memcpy(out.magic, INDEX_MANIFEST_MAGIC, sizeof(INDEX_MANIFEST_MAGIC));
+    out.version = INDEX_MANIFEST_VERSION;
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f) {
+        perror("[indexador] fopen manifest");
+        return -1;
+    }
+    int rc = fwrite(&out, sizeof(out), 1, f) == 1 ? 0 : -1;
+    if (fclose(f) != 0) rc = -1;
+    if (rc == 0 && rename(tmp_path, path) != 0) rc = -1;
+    if (rc != 0) {
+        perror("[indexador] No se pudo escribir el manifest");
+        unlink(tmp_path);
+    }
+    return rc;
+}
+
+int map_emotion_index(EmotionIndex *eidx, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("[map_emotion_index] No se pudo abrir archivo binario");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IndexFileHeader)) {
+        fprintf(stderr, "[map_emotion_index] Archivo demasiado pequeño: %s\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("[map_emotion_index] mmap");
+        return -1;
+    }
 
-            for (int i = 0; i < NUM_THREADS; i++) {
-                pthread_create(&threads[i], NULL, process_lines, &args[i]);
+    const IndexFileHeader *hdr = map;
+    uint64_t size = (uint64_t)st.st_size;
+    if (memcmp(hdr->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        hdr->version != INDEX_VERSION ||
+        hdr->arousal_levels != AROUSAL_LEVELS ||
+        hdr->file_size != size ||
+        hdr->artists_offset != sizeof(IndexFileHeader) + sizeof(IndexArousalEntry) * AROUSAL_LEVELS ||
+        hdr->postings_offset != hdr->artists_offset + sizeof(IndexArtistEntry) * hdr->artist_count ||
+        hdr->file_size != hdr->postings_offset + hdr->postings_size) {
+        fprintf(stderr, "[map_emotion_index] Formato inválido o desactualizado: %s\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    eidx->map = map;
+    eidx->map_size = st.st_size;
+    eidx->header = hdr;
+    eidx->arousal_dir = (const IndexArousalEntry *)((const char *)map + sizeof(IndexFileHeader));
+    eidx->artist_table = (const IndexArtistEntry *)((const char *)map + hdr->artists_offset);
+    eidx->postings = (const uint8_t *)map + hdr->postings_offset;
+    return 0;
+}
+
+void unmap_emotion_index(EmotionIndex *eidx) {
+    if (eidx->map) munmap(eidx->map, eidx->map_size);
+    eidx->map = NULL;
+    eidx->map_size = 0;
+    eidx->header = NULL;
+    eidx->arousal_dir = NULL;
+    eidx->artist_table = NULL;
+    eidx->postings = NULL;
+}
+
+int map_emotion_segments(EmotionIndex *eidx, const char *emotion, uint32_t segment_count) {
+    EmotionIndex *tail = NULL;
+    for (uint32_t k = 0; k <= segment_count; k++) {
+        char path[PATH_MAX];
+        index_segment_path(path, sizeof(path), emotion, k);
+        if (access(path, F_OK) != 0) continue; // La emoción no tuvo filas en ese segmento
+
+        EmotionIndex *seg = tail ? calloc(1, sizeof(EmotionIndex)) : eidx;
+        if (!seg) {
+            perror("malloc");
+            return -1;
+        }
+        if (map_emotion_index(seg, path) != 0) {
+            if (seg != eidx) free(seg);
+            return -1;
+        }
+        snprintf(seg->emotion, sizeof(seg->emotion), "%s", emotion);
+        if (tail) tail->next_segment = seg;
+        tail = seg;
+    }
+    if (!tail) fprintf(stderr, "[map_emotion_segments] No hay índice para '%s'\n", emotion);
+    return tail ? 0 : -1;
+}
+
+size_t emotion_index_size(const EmotionIndex *eidx) {
+    size_t bytes = 0;
+    for (; eidx; eidx = eidx->next_segment) bytes += eidx->map_size;
+    return bytes;
+}
+
+void prefault_emotion_index(const EmotionIndex *eidx) {
+    long page = sysconf(_SC_PAGESIZE);
+    for (; eidx; eidx = eidx->next_segment) {
+        if (!eidx->map) continue;
+        posix_madvise(eidx->map, eidx->map_size, POSIX_MADV_WILLNEED);
+
+        // Leer un byte por página obliga a que el fallo de página ocurra ahora y no en la consulta
+        volatile const char *bytes = eidx->map;
+        char sink = 0;
+        for (size_t off = 0; off < eidx->map_size; off += page) sink ^= bytes[off];
+        (void)sink;
+    }
+}
+
+const IndexArtistEntry *find_artist_entry(const EmotionIndex *eidx, int arousal, uint32_t artist_id) {
+    if (!eidx || !eidx->map || arousal < 0 || arousal >= AROUSAL_LEVELS) return NULL;
+
+    const IndexFileHeader *hdr = eidx->header;
+    const IndexArousalEntry *dir = &eidx->arousal_dir[arousal];
+    if ((uint64_t)dir->first_artist + dir->artist_count > hdr->artist_count) return NULL;
+
+    // Búsqueda binaria: los artistas de cada arousal están ordenados por id
+    const IndexArtistEntry *table = &eidx->artist_table[dir->first_artist];
+    uint32_t lo = 0, hi = dir->artist_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const IndexArtistEntry *entry = &table[mid];
+        if (entry->artist_id == artist_id) {
+            if ((uint64_t)entry->data_offset + entry->data_size > hdr->postings_size) return NULL;
+            return entry;
+        }
+        if (artist_id < entry->artist_id) hi = mid;
+        else lo = mid + 1;
+    }
+    return NULL;
+}
+
+int decode_positions(const EmotionIndex *eidx, const IndexArtistEntry *entry, int64_t *out) {
+    if (!eidx || !eidx->map || (uint64_t)entry->data_offset + entry->data_size > eidx->header->postings_size)
+        return -1;
+    return posting_decode(eidx->postings + entry->data_offset, entry->data_size, entry->position_count, out);
+}
+
+uint64_t count_positions(const EmotionIndex *eidx, int arousal, uint32_t artist_id) {
+    uint64_t total = 0;
+    for (; eidx; eidx = eidx->next_segment) {
+        const IndexArtistEntry *entry = find_artist_entry(eidx, arousal, artist_id);
+        if (entry) total += entry->position_count;
+    }
+    return total;
+}
+
+int collect_positions(const EmotionIndex *eidx, int arousal, uint32_t artist_id, int64_t *out) {
+    for (; eidx; eidx = eidx->next_segment) {
+        const IndexArtistEntry *entry = find_artist_entry(eidx, arousal, artist_id);
+        if (!entry) continue;
+        if (decode_positions(eidx, entry, out) != 0) return -1;
+        out += entry->position_count;
+    }
+    return 0;
+}
+
+static void index_line(PartialIndex *partial, const char *line, const char *end, long pos) {
+    CsvSpan tokens[NUM_FIELDS];
+    csv_split_fields(line, end, tokens, NUM_FIELDS);
+
+    char artist[MAX_FIELD];
+    csv_span_copy(artist, sizeof(artist), &tokens[2]);
+    sanitize_input(artist);
+
+    int arousal = (int) csv_span_atof(&tokens[6]);
+
+    // Cada emoción del campo seeds va entre comillas simples
+    const char *q = tokens[3].start;
+    const char *seeds_end = tokens[3].start + (tokens[3].len < MAX_FIELD - 1 ? tokens[3].len : MAX_FIELD - 1);
+    while ((q = memchr(q, '\'', seeds_end - q)) != NULL) {
+        q++;
+        const char *close = memchr(q, '\'', seeds_end - q);
+        if (!close) break;
+
+        char emotion_clean[MAX_FIELD];
+        CsvSpan seed = { q, (size_t)(close - q) };
+        csv_span_copy(emotion_clean, sizeof(emotion_clean), &seed);
+        sanitize_input(emotion_clean);
+
+        if (strlen(emotion_clean) > 0)
+            partial_add_position(partial, emotion_clean, arousal, artist, pos);
+
+        q = close + 1;
+    }
+}
+
+// Indexa las líneas del rango [begin, end) (alineado a inicios de línea).
+// El offset de cada línea en el CSV es su posición en el índice.
+static long index_range(PartialIndex *partial, const char *data, uint64_t begin, uint64_t end) {
+    long lines = 0;
+    uint64_t pos = begin;
+    while (pos < end) {
+        const char *line = data + pos;
+        const char *newline = memchr(line, '\n', end - pos);
+        const char *line_end = newline ? newline : data + end;
+
+        index_line(partial, line, line_end, (long)pos);
+        lines++;
+        pos = (uint64_t)(line_end - data) + 1;
+    }
+    return lines;
+}
+
+// ------------- INDEXADOR PRINCIPAL -------------
+
+static void runs_folder_path(char *buf, size_t size) {
+    snprintf(buf, size, "%s%s", index_folder, INDEX_RUNS_SUBFOLDER);
+}
+
+static void run_file_path(char *buf, size_t size, uint32_t run, const char *emotion) {
+    snprintf(buf, size, "%s%srun%u_%s.bin", index_folder, INDEX_RUNS_SUBFOLDER, run, emotion);
+}
+
+// Borra los runs de esta construcción (o los que dejó una interrumpida)
+static void remove_index_runs(void) {
+    char runs_folder[PATH_MAX];
+    runs_folder_path(runs_folder, sizeof(runs_folder));
+    DIR *dir = opendir(runs_folder);
+    if (dir) {
+        struct dirent *de;
+        while ((de = readdir(dir)) != NULL) {
+            if (strncmp(de->d_name, "run", 3) != 0) continue;
+            char path[PATH_MAX + 256];
+            snprintf(path, sizeof(path), "%s%s", runs_folder, de->d_name);
+            if (unlink(path) != 0) perror("[indexador] unlink");
+        }
+        closedir(dir);
+        rmdir(runs_folder);
+    }
+    free(run_emotions);
+    run_emotions = NULL;
+    run_emotion_count = run_emotion_capacity = 0;
+    spilled_runs = 0;
+}
+
+static int write_run_emotion(void *ctx, int index) {
+    EmotionWriteJob *job = ctx;
+    char path[PATH_MAX];
+    run_file_path(path, sizeof(path), job->number, job->emotions[index]->emotion);
+    return write_emotion_file(job->emotions[index], path);
+}
+
+static size_t index_memory_in_use(void) {
+    size_t bytes = 0;
+    for (EmotionIndex *curr = emotion_index_head; curr; curr = curr->next) bytes += curr->arena.reserved;
+    return bytes;
+}
+
+static size_t index_memory_limit(void) {
+    if (index_memory_budget > 0) return index_memory_budget;
+    const char *mb = getenv("INDEX_MEMORY_MB");
+    return (size_t)(mb && atol(mb) > 0 ? atol(mb) : DEFAULT_INDEX_MEMORY_MB) << 20;
+}
+
+// Vuelca el índice en memoria como un run ordenado (mismo formato que los índices)
+// y libera las emociones. El diccionario de artistas se mantiene en memoria.
+static int spill_index_run(void) {
+    char runs_folder[PATH_MAX];
+    runs_folder_path(runs_folder, sizeof(runs_folder));
+    make_index_folder();
+    mkdir(runs_folder, 0775);
+
+    size_t in_use = index_memory_in_use();
+    int count;
+    EmotionWriteJob job = { .emotions = emotion_array(&count), .number = spilled_runs };
+    if (!job.emotions) return -1;
+    int failed = write_in_parallel(count, write_run_emotion, &job);
+    free(job.emotions);
+    if (failed) return -1;
+
+    for (EmotionIndex *curr = emotion_index_head; curr; curr = curr->next) {
+        int seen = 0;
+        for (int i = 0; i < run_emotion_count && !seen; i++) seen = strcmp(run_emotions[i], curr->emotion) == 0;
+        if (seen) continue;
+        if (run_emotion_count == run_emotion_capacity) {
+            int capacity = run_emotion_capacity ? run_emotion_capacity * 2 : 32;
+            char (*grown)[MAX_FIELD] = realloc(run_emotions, sizeof(*run_emotions) * capacity);
+            if (!grown) {
+                perror("realloc");
+                return -1;
             }
+            run_emotions = grown;
+            run_emotion_capacity = capacity;
+        }
+        memcpy(run_emotions[run_emotion_count++], curr->emotion, MAX_FIELD);
+    }
+
+    report_arena_usage();
+    for (EmotionIndex *curr = emotion_index_head; curr; curr = curr->next) {
+        for (int i = 0; i < AROUSAL_LEVELS; i++) {
+            spilled_entries += curr->arousals[i].count;
+            spilled_slots += curr->arousals[i].slot_count;
+            arousal_placement_stats(&curr->arousals[i], &spilled_placement);
+        }
+    }
+    release_emotions();
+    printf("[indexador] Run %u volcado a disco (%.1f MB en memoria)\n", spilled_runs, in_use / 1048576.0);
+    spilled_runs++;
+    return 0;
+}
+
+// Mezcla todos los runs de una emoción en su archivo del segmento
+static int merge_emotion_runs(void *ctx, int index) {
+    uint32_t segment = *(const uint32_t *)ctx;
+    EmotionIndex *runs = calloc(spilled_runs, sizeof(EmotionIndex));
+    const EmotionIndex **mapped = calloc(spilled_runs, sizeof(EmotionIndex *));
+    if (!runs || !mapped) {
+        perror("malloc");
+        free(runs);
+        free(mapped);
+        return -1;
+    }
+
+    // Un run que existe pero no se puede mapear dejaría el índice sin sus posiciones
+    int nruns = 0, rc = 0;
+    for (uint32_t r = 0; r < spilled_runs; r++) {
+        char path[PATH_MAX];
+        run_file_path(path, sizeof(path), r, run_emotions[index]);
+        if (access(path, F_OK) != 0) continue; // La emoción no tuvo filas en ese run
+        if (map_emotion_index(&runs[nruns], path) != 0) {
+            rc = -1;
+            break;
+        }
+        mapped[nruns] = &runs[nruns];
+        nruns++;
+    }
+
+    char path[PATH_MAX];
+    index_segment_path(path, sizeof(path), run_emotions[index], segment);
+    if (rc == 0) rc = merge_index_runs(mapped, nruns, path);
+    if (rc != 0) fprintf(stderr, "[indexador] No se pudieron mezclar los runs de '%s'\n", run_emotions[index]);
+    for (int r = 0; r < nruns; r++) unmap_emotion_index(&runs[r]);
+    free(runs);
+    free(mapped);
+    return rc;
+}
+
+// Escribe el segmento: directo desde memoria si todo cupo en el presupuesto,
+// o con un merge de k vías de los runs volcados si no. Devuelve -1 si algo no se
+// pudo escribir.
+static int flush_index_segment(uint32_t segment) {
+    if (spilled_runs == 0) return save_index_segment(segment);
+
+    if (emotion_index_head && spill_index_run() != 0) {
+        fprintf(stderr, "[indexador] No se pudo volcar el último run\n");
+        return -1;
+    }
+
+    char dict_path[PATH_MAX];
+    snprintf(dict_path, sizeof(dict_path), "%s%s", index_folder, ARTIST_DICT_FILE);
+    if (artist_dict_save(&artist_dict, dict_path) != 0) {
+        fprintf(stderr, "[indexador] No se pudo guardar el diccionario de artistas\n");
+        return -1;
+    }
+
+    printf("[indexador] Mezclando %u runs de %d emociones...\n", spilled_runs, run_emotion_count);
+    int failed = write_in_parallel(run_emotion_count, merge_emotion_runs, &segment);
+    remove_index_runs();
+    if (failed) return -1;
+
+    if (segment == 0) printf("[indexador] Índice guardado.\n");
+    else printf("[indexador] Segmento %u guardado.\n", segment);
+    return 0;
+}
+
+// Corta una indexación que falló: no se escribe el manifest ni quedan runs en disco.
+// Devuelve -1 para que buildIndex y updateIndex lo propaguen.
+static int abort_index_build(MappedCsv *csv) {
+    fprintf(stderr, "[indexador] Indexación abortada: no se escribe el índice\n");
+    remove_index_runs();
+    unmap_csv(csv);
+    clear_index();
+    return -1;
+}
+
+// Informes del final de una indexación ya escrita. Devuelve -1 si las tablas hash
+// quedaron agrupadas.
+static int report_index_build(void) {
+    report_arena_usage();
+    if (report_hash_stats() == 0) return 0;
+    fprintf(stderr, "[indexador] Las tablas hash quedaron agrupadas: revisar el hash o la ubicación\n");
+    return -1;
+}
+
+int map_csv(const char *filename, MappedCsv *csv) {
+    csv->data = NULL;
+    csv->size = 0;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    csv->size = (size_t)st.st_size;
+    if (csv->size > 0) {
+        void *map = mmap(NULL, csv->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        posix_madvise(map, csv->size, POSIX_MADV_SEQUENTIAL);
+        csv->data = map;
+    }
+    close(fd);
+    return 0;
+}
+
+void unmap_csv(MappedCsv *csv) {
+    if (csv->data) munmap((void *)csv->data, csv->size);
+    csv->data = NULL;
+    csv->size = 0;
+}
+
+// Primer inicio de línea en o después de `pos` (o `limit` si no hay otro)
+static uint64_t next_line_start(const MappedCsv *csv, uint64_t pos, uint64_t limit) {
+    if (pos == 0 || pos >= limit) return pos < limit ? pos : limit;
+    if (csv->data[pos - 1] == '\n') return pos;
+    const char *newline = memchr(csv->data + pos, '\n', limit - pos);
+    return newline ? (uint64_t)(newline - csv->data) + 1 : limit;
+}
+
+// ------------- PIPELINE DE INDEXACIÓN -------------
+// lector -> [cola de bloques] -> index_threads parsers -> [cola de chunks] -> mezcla
+// El lector trae a memoria las páginas de cada bloque mientras los parsers trabajan
+// con los anteriores, y la mezcla de un chunk en el índice global ocurre mientras se
+// parsea el siguiente. Las colas acotadas fijan la memoria en uso.
+
+enum { BLOCK_DATA, BLOCK_CHUNK_END, BLOCK_INPUT_END };
+
+typedef struct {
+    uint64_t begin;
+    uint64_t end;
+    int kind;
+} CsvBlock;
+
+typedef struct IndexPipeline {
+    const MappedCsv *csv;
+    uint64_t start;
+
+    CsvBlock blocks[PIPELINE_BLOCKS_PER_THREAD * MAX_INDEX_THREADS];
+    int block_capacity;               // Bloques leídos por adelantado como máximo
+    int block_head, block_count;
+    PartialIndex *chunks[PIPELINE_QUEUE_CHUNKS];  // Parciales de un chunk (uno por parser); NULL = fin
+    int chunk_head, chunk_count;
+    pthread_mutex_t lock;
+    pthread_cond_t blocks_ready, blocks_free, chunks_ready, chunks_free;
+
+    pthread_barrier_t chunk_barrier;  // Los parsers cierran cada chunk juntos
+    PartialIndex *current;            // Parciales del chunk en curso
+    int stop;                         // La mezcla falló: el lector corta la entrada (protegido por lock)
+} IndexPipeline;
+
+static void pipeline_push_block(IndexPipeline *p, CsvBlock block) {
+    pthread_mutex_lock(&p->lock);
+    while (p->block_count == p->block_capacity) pthread_cond_wait(&p->blocks_free, &p->lock);
+    p->blocks[(p->block_head + p->block_count++) % p->block_capacity] = block;
+    pthread_cond_signal(&p->blocks_ready);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static CsvBlock pipeline_pop_block(IndexPipeline *p) {
+    pthread_mutex_lock(&p->lock);
+    while (p->block_count == 0) pthread_cond_wait(&p->blocks_ready, &p->lock);
+    CsvBlock block = p->blocks[p->block_head];
+    p->block_head = (p->block_head + 1) % p->block_capacity;
+    p->block_count--;
+    pthread_cond_signal(&p->blocks_free);
+    pthread_mutex_unlock(&p->lock);
+    return block;
+}
+
+static void pipeline_push_chunk(IndexPipeline *p, PartialIndex *partials) {
+    pthread_mutex_lock(&p->lock);
+    while (p->chunk_count == PIPELINE_QUEUE_CHUNKS) pthread_cond_wait(&p->chunks_free, &p->lock);
+    p->chunks[(p->chunk_head + p->chunk_count++) % PIPELINE_QUEUE_CHUNKS] = partials;
+    pthread_cond_signal(&p->chunks_ready);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static PartialIndex *pipeline_pop_chunk(IndexPipeline *p) {
+    pthread_mutex_lock(&p->lock);
+    while (p->chunk_count == 0) pthread_cond_wait(&p->chunks_ready, &p->lock);
+    PartialIndex *partials = p->chunks[p->chunk_head];
+    p->chunk_head = (p->chunk_head + 1) % PIPELINE_QUEUE_CHUNKS;
+    p->chunk_count--;
+    pthread_cond_signal(&p->chunks_free);
+    pthread_mutex_unlock(&p->lock);
+    return partials;
+}
 
-            for (int i = 0; i < NUM_THREADS; i++)
-                pthread_join(threads[i], NULL);
+static int pipeline_stopped(IndexPipeline *p) {
+    pthread_mutex_lock(&p->lock);
+    int stop = p->stop;
+    pthread_mutex_unlock(&p->lock);
+    return stop;
+}
 
-            for (int i = 0; i < count; i++) free(lines[i]);
-            count = 0;
+// Lector: corta el CSV en bloques alineados a líneas y trae sus páginas a memoria
+static void *pipeline_reader(void *arg) {
+    IndexPipeline *p = arg;
+    const MappedCsv *csv = p->csv;
+    long page = sysconf(_SC_PAGESIZE);
 
-            save_index_to_disk();
+    uint64_t pos = p->start, chunk_bytes = 0;
+    while (pos < csv->size && !pipeline_stopped(p)) {
+        uint64_t end = next_line_start(csv, pos + PIPELINE_BLOCK_BYTES < csv->size ? pos + PIPELINE_BLOCK_BYTES
+                                                                                   : csv->size, csv->size);
+        posix_madvise((void *)(csv->data + (pos & ~(uint64_t)(page - 1))),
+                      end - (pos & ~(uint64_t)(page - 1)), POSIX_MADV_WILLNEED);
+        volatile const char *bytes = csv->data;
+        char sink = 0;
+        for (uint64_t off = pos; off < end; off += page) sink ^= bytes[off];
+        (void)sink;
+
+        pipeline_push_block(p, (CsvBlock){ pos, end, BLOCK_DATA });
+        chunk_bytes += end - pos;
+        pos = end;
+
+        if (chunk_bytes >= index_chunk_bytes && pos < csv->size) {
+            for (int i = 0; i < index_threads; i++) pipeline_push_block(p, (CsvBlock){ 0, 0, BLOCK_CHUNK_END });
+            chunk_bytes = 0;
         }
     }
+    for (int i = 0; i < index_threads; i++) pipeline_push_block(p, (CsvBlock){ 0, 0, BLOCK_INPUT_END });
+    return NULL;
+}
 
-    // Procesar últimas líneas si quedaron
-    if (count > 0) {
-        printf("[indexador] Procesando último chunk...\n");
-        pthread_t threads[NUM_THREADS];
-        ThreadArgs args[NUM_THREADS];
-        long chunk_per_thread = count / NUM_THREADS;
+// Parser: indexa bloques en su parcial. Los bloques salen de la cola en orden, así que
+// cada parcial recibe posiciones crecientes. Al cerrar un chunk, todos los parsers se
+// esperan y uno entrega los parciales a la mezcla.
+void *process_lines(void *arg) {
+    ThreadArgs *args = (ThreadArgs *)arg;
+    IndexPipeline *p = args->pipeline;
+    args->num_lines = 0;
 
-        for (int i = 0; i < NUM_THREADS; i++) {
-            args[i].id = i;
-            args[i].lines = &lines[i * chunk_per_thread];
-            args[i].positions = &positions[i * chunk_per_thread];
-            args[i].num_lines = (i == NUM_THREADS - 1) ? (count - i * chunk_per_thread) : chunk_per_thread;
+    while (1) {
+        CsvBlock block = pipeline_pop_block(p);
+        if (block.kind == BLOCK_DATA) {
+            PartialIndex *partial = &p->current[args->id];
+            long lines = index_range(partial, p->csv->data, block.begin, block.end);
+            args->num_lines += lines;
+            partial->rows += lines;
+            partial->end = block.end;
+            continue;
         }
 
-        for (int i = 0; i < NUM_THREADS; i++) {
-           pthread_create(&threads[i], NULL, process_lines, &args[i]);
+        if (pthread_barrier_wait(&p->chunk_barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+            pipeline_push_chunk(p, p->current);
+            if (block.kind == BLOCK_INPUT_END) {
+                p->current = NULL;
+                pipeline_push_chunk(p, NULL);
+            } else {
+                p->current = calloc(index_threads, sizeof(PartialIndex));
+                if (!p->current) {
+                    perror("calloc");
+                    exit(1);
+                }
+            }
         }
+        pthread_barrier_wait(&p->chunk_barrier);
+        if (block.kind == BLOCK_INPUT_END) break;
+    }
 
-        for (int i = 0; i < NUM_THREADS; i++)
-            pthread_join(threads[i], NULL);
+    return NULL;
+}
 
-        for (int i = 0; i < count; i++) free(lines[i]);
+static double elapsed_seconds(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - since->tv_sec) + (now.tv_nsec - since->tv_nsec) / 1e9;
+}
+
+// Avance de la indexación al entrar cada chunk a la mezcla
+static void report_index_progress(long chunk_id, long rows, uint64_t bytes, uint64_t total_bytes,
+                                  const struct timespec *began) {
+    double secs = elapsed_seconds(began);
+    if (secs <= 0) secs = 1e-9;
+    printf("[indexador] Mezclando chunk %ld: %ld filas, %.1f/%.1f MB (%.0f filas/s, %.1f MB/s)\n",
+           chunk_id, rows, bytes / 1048576.0, total_bytes / 1048576.0, rows / secs, bytes / 1048576.0 / secs);
+}
+
+// Indexa el CSV mapeado desde `start` hasta el final. El hilo que llama hace la
+// etapa de mezcla: vuelca cada chunk en el índice global y, cuando el índice en
+// memoria supera el presupuesto, lo vuelca como un run (flush_index_segment los
+// mezcla al final). Devuelve las filas leídas, o -1 si la mezcla o un run fallaron:
+// en ese caso se deja de leer el CSV y el índice en memoria no debe escribirse.
+static long index_csv_rows(const MappedCsv *csv, uint64_t start) {
+    remove_index_runs();
+    size_t limit = index_memory_limit();
+
+    IndexPipeline pipeline = {
+        .csv = csv,
+        .start = start,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .blocks_ready = PTHREAD_COND_INITIALIZER,
+        .blocks_free = PTHREAD_COND_INITIALIZER,
+        .chunks_ready = PTHREAD_COND_INITIALIZER,
+        .chunks_free = PTHREAD_COND_INITIALIZER,
+        .block_capacity = PIPELINE_BLOCKS_PER_THREAD * index_threads,
+    };
+    pipeline.current = calloc(index_threads, sizeof(PartialIndex));
+    if (!pipeline.current || pthread_barrier_init(&pipeline.chunk_barrier, NULL, index_threads) != 0) {
+        perror("[indexador] No se pudo iniciar el pipeline");
+        free(pipeline.current);
+        return -1;
     }
 
-    free(lines);
-    free(positions);
-    fclose(file);
+    pthread_t reader, parsers[MAX_INDEX_THREADS];
+    ThreadArgs args[MAX_INDEX_THREADS];
+    pthread_create(&reader, NULL, pipeline_reader, &pipeline);
+    for (int i = 0; i < index_threads; i++) {
+        args[i].id = i;
+        args[i].pipeline = &pipeline;
+        args[i].num_lines = 0;
+        pthread_create(&parsers[i], NULL, process_lines, &args[i]);
+    }
+
+    long chunk_id = 0, rows = 0;
+    int failed = 0;
+    uint64_t done = start;
+    struct timespec began;
+    clock_gettime(CLOCK_MONOTONIC, &began);
+    PartialIndex *partials;
+    while ((partials = pipeline_pop_chunk(&pipeline)) != NULL) {
+        for (int i = 0; i < index_threads; i++) {
+            rows += partials[i].rows;
+            if (partials[i].end > done) done = partials[i].end;
+        }
+        // Tras un fallo solo se descartan los chunks que ya estaban en camino
+        if (!failed) {
+            report_index_progress(++chunk_id, rows, done - start, csv->size - start, &began);
+            for (int i = 0; i < index_threads && !failed; i++) failed = partials[i].failed;
+            if (failed) {
+                fprintf(stderr, "[indexador] Sin memoria al indexar el chunk %ld\n", chunk_id);
+            } else if (merge_partial_indexes(partials) != 0) {
+                fprintf(stderr, "[indexador] No se pudo mezclar el chunk %ld\n", chunk_id);
+                failed = 1;
+            } else if (index_memory_in_use() > limit && spill_index_run() != 0) {
+                fprintf(stderr, "[indexador] No se pudo volcar el run %u\n", spilled_runs);
+                failed = 1;
+            }
+            if (failed) {
+                pthread_mutex_lock(&pipeline.lock);
+                pipeline.stop = 1;
+                pthread_mutex_unlock(&pipeline.lock);
+            }
+        }
+        for (int i = 0; i < index_threads; i++) free_partial_index(&partials[i]);
+        free(partials);
+    }
+
+    pthread_join(reader, NULL);
+    long total = 0;
+    for (int i = 0; i < index_threads; i++) {
+        pthread_join(parsers[i], NULL);
+        total += args[i].num_lines;
+    }
+    pthread_barrier_destroy(&pipeline.chunk_barrier);
+    return failed ? -1 : total;
+}
+
+// Hash de los primeros bytes del CSV: si cambian, el archivo no es el mismo que se indexó
+static uint64_t csv_prefix_hash(const MappedCsv *csv, uint64_t indexed_bytes) {
+    uint64_t limit = indexed_bytes < INDEX_PREFIX_BYTES ? indexed_bytes : INDEX_PREFIX_BYTES;
+    if (limit > csv->size) limit = csv->size;
+
+    uint64_t hash = 1469598103934665603ULL;
+    for (uint64_t i = 0; i < limit; i++) {
+        hash ^= (unsigned char)csv->data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash ^ limit;
+}
+
+// Borra los segmentos delta con número mayor a `keep` (restos de otra indexación)
+static void remove_index_segments(uint32_t keep) {
+    DIR *dir = opendir(index_folder);
+    if (!dir) return;
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        char emotion[MAX_FIELD];
+        uint32_t segment;
+        if (parse_index_file_name(de->d_name, emotion, &segment) != 0 || segment <= keep) continue;
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s%s", index_folder, de->d_name);
+        if (unlink(path) != 0) perror("[indexador] unlink");
+    }
+    closedir(dir);
+}
+
+int buildIndex(const char *filename) {
+    MappedCsv csv;
+    if (map_csv(filename, &csv) != 0) {
+        perror("Error abriendo CSV");
+        return -1;
+    }
+
+    // Skip header
+    const char *header_end = csv.size ? memchr(csv.data, '\n', csv.size) : NULL;
+    if (csv.size == 0) {
+        fprintf(stderr, "Error leyendo el header del CSV\n");
+        unmap_csv(&csv);
+        return -1;
+    }
+    uint64_t start = header_end ? (uint64_t)(header_end - csv.data) + 1 : csv.size;
+
+    // Una reconstrucción completa reemplaza a todos los segmentos anteriores
+    remove_index_segments(0);
+
+    long total = index_csv_rows(&csv, start);
+    if (total < 0) return abort_index_build(&csv);
+
+    IndexManifest manifest = {0};
+    manifest.indexed_bytes = csv.size;
+    manifest.prefix_hash = csv_prefix_hash(&csv, manifest.indexed_bytes);
+    manifest.rows = (uint64_t)total;
+    unmap_csv(&csv);
 
     printf("[indexador] Total de canciones procesadas: %ld\n", total);
-    save_index_to_disk();
+    if (flush_index_segment(0) != 0) return abort_index_build(&csv);
+
+    // El manifest va al final: solo describe índices que ya están completos en disco
+    manifest.dictionary_id = artist_dict.dictionary_id;
+    if (write_index_manifest(&manifest) != 0) return abort_index_build(&csv);
+
+    return report_index_build();
+}
+
+int updateIndex(const char *filename) {
+    IndexManifest manifest;
+    if (read_index_manifest(&manifest) != 0) {
+        printf("[indexador] No hay manifest: se construye el índice completo\n");
+        return buildIndex(filename);
+    }
+
+    MappedCsv csv;
+    if (map_csv(filename, &csv) != 0) {
+        perror("Error abriendo CSV");
+        return -1;
+    }
+
+    // Solo se admiten filas agregadas al final: un CSV más corto o con otro inicio se reindexa
+    if (csv.size < manifest.indexed_bytes || csv_prefix_hash(&csv, manifest.indexed_bytes) != manifest.prefix_hash) {
+        printf("[indexador] El CSV cambió desde la última indexación: se reconstruye el índice\n");
+        unmap_csv(&csv);
+        clear_index();
+        return buildIndex(filename);
+    }
+    if (csv.size == manifest.indexed_bytes) {
+        printf("[indexador] No hay filas nuevas (%llu filas indexadas en %u segmentos delta)\n",
+               (unsigned long long)manifest.rows, manifest.segment_count);
+        unmap_csv(&csv);
+        return 0;
+    }
+
+    // Los artistas nuevos se agregan al diccionario existente sin cambiar los ids ya usados
+    char dict_path[PATH_MAX];
+    snprintf(dict_path, sizeof(dict_path), "%s%s", index_folder, ARTIST_DICT_FILE);
+    clear_index();
+    if (artist_dict_load(&artist_dict, dict_path) != 0 || artist_dict.dictionary_id != manifest.dictionary_id) {
+        printf("[indexador] El diccionario de artistas no corresponde al manifest: se reconstruye el índice\n");
+        unmap_csv(&csv);
+        clear_index();
+        return buildIndex(filename);
+    }
+
+    uint32_t segment = manifest.segment_count + 1;
+    remove_index_segments(manifest.segment_count);
+    printf("[indexador] Indexando %llu bytes nuevos en el segmento %u...\n",
+           (unsigned long long)(csv.size - manifest.indexed_bytes), segment);
+
+    long total = index_csv_rows(&csv, manifest.indexed_bytes);
+    if (total < 0) return abort_index_build(&csv);
+    manifest.indexed_bytes = csv.size;
+    unmap_csv(&csv);
+
+    printf("[indexador] Canciones nuevas procesadas: %ld\n", total);
+    if (flush_index_segment(segment) != 0) return abort_index_build(&csv);
+
+    manifest.segment_count = segment;
+    manifest.rows += (uint64_t)total;
+    if (write_index_manifest(&manifest) != 0) return abort_index_build(&csv);
+
+    return report_index_build();
+}
+
+int mergeIndexSegments(void) {
+    IndexManifest manifest;
+    if (read_index_manifest(&manifest) != 0) {
+        fprintf(stderr, "[indexador] No hay manifest: no hay segmentos que fundir\n");
+        return -1;
+    }
+    if (manifest.segment_count == 0) {
+        printf("[indexador] El índice no tiene segmentos delta\n");
+        return 0;
+    }
+
+    DIR *dir = opendir(index_folder);
+    if (!dir) {
+        perror("[indexador] No se pudo abrir la carpeta de índices");
+        return -1;
+    }
+
+    // Emociones que tienen base o algún segmento vigente
+    char (*emotions)[MAX_FIELD] = NULL;
+    int count = 0, capacity = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        char emotion[MAX_FIELD];
+        uint32_t segment;
+        if (parse_index_file_name(de->d_name, emotion, &segment) != 0 || segment > manifest.segment_count)
+            continue;
+
+        int seen = 0;
+        for (int i = 0; i < count && !seen; i++) seen = strcmp(emotions[i], emotion) == 0;
+        if (seen) continue;
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 32;
+            char (*grown)[MAX_FIELD] = realloc(emotions, sizeof(*emotions) * capacity);
+            if (!grown) {
+                // Con la lista incompleta, el manifest nuevo dejaría sin fundir (y borraría)
+                // los deltas de las emociones que faltan: no se toca nada
+                perror("realloc");
+                closedir(dir);
+                free(emotions);
+                return -1;
+            }
+            emotions = grown;
+        }
+        memcpy(emotions[count++], emotion, MAX_FIELD);
+    }
+    closedir(dir);
+
+    // Los ids de artista no cambian al fundir: se conserva el diccionario del manifest
+    clear_index();
+    artist_dict.dictionary_id = manifest.dictionary_id;
+
+    int failed = 0;
+    for (int i = 0; i < count && !failed; i++) {
+        // Los segmentos son runs ya ordenados: se funden con el mismo merge de k vías
+        EmotionIndex *chain = calloc(1, sizeof(EmotionIndex));
+        const EmotionIndex **segments = malloc(sizeof(EmotionIndex *) * (manifest.segment_count + 1));
+        int nsegments = 0;
+        failed = !chain || !segments || map_emotion_segments(chain, emotions[i], manifest.segment_count) != 0;
+        for (const EmotionIndex *seg = failed ? NULL : chain; seg; seg = seg->next_segment)
+            segments[nsegments++] = seg;
+
+        char path[PATH_MAX];
+        index_segment_path(path, sizeof(path), emotions[i], 0);
+        failed = failed || merge_index_runs(segments, nsegments, path) != 0;
+        if (failed) fprintf(stderr, "[indexador] No se pudieron fundir los segmentos de '%s'\n", emotions[i]);
+        else printf("[indexador] '%s' fundida en su archivo base\n", emotions[i]);
+
+        free(segments);
+        free_emotion_index(chain);
+    }
+    free(emotions);
+    clear_index();
+    if (failed) return -1;
+
+    // Primero el manifest (deja de referir los deltas) y después se borran los archivos
+    uint32_t merged_segments = manifest.segment_count;
+    manifest.segment_count = 0;
+    if (write_index_manifest(&manifest) != 0) return -1;
+    remove_index_segments(0);
+    printf("[indexador] %u segmentos fundidos en %d emociones\n", merged_segments, count);
+    return 0;
 }
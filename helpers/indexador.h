@@ -4,48 +4,145 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include <pthread.h>
 
+#include "arena.h"
+#include "artist_dict.h"
+#include "csv.h"
+#include "postings.h"
+
 #define MAX_FIELD 128
 #define MAX_SEEDS 10
-#define MAX_ARTIST_BUCKETS 211
-#define INDEX_FOLDER "./output/emotions/"
+#define INDEX_FOLDER "./output/emotions/"   // Carpeta de índices por defecto (index_folder)
 #define LINE_BUFFER 4096
 #define NUM_FIELDS 12
-#define CHUNK_SIZE 500000
-#define NUM_THREADS 6
+#ifndef CHUNK_BYTES
+#define CHUNK_BYTES (64 << 20)    // Bytes del CSV por chunk por defecto (index_chunk_bytes)
+#endif
+#define PIPELINE_BLOCK_BYTES (1 << 20)         // Bloque que el lector entrega a los parsers
+#define PIPELINE_BLOCKS_PER_THREAD 4           // Bloques leídos por adelantado por cada parser
+#define PIPELINE_QUEUE_CHUNKS 1                 // Chunks parseados esperando a la mezcla
+#define NUM_THREADS 8             // Hilos del indexador por defecto (index_threads)
+#define MAX_INDEX_THREADS 64
+#define AROUSAL_LEVELS 101
+#define DEFAULT_INDEX_MEMORY_MB 1024  // Memoria del índice en construcción antes de volcar un run (INDEX_MEMORY_MB)
+#define INDEX_RUNS_SUBFOLDER "runs/"   // Dentro de la carpeta de índices
+#define INDEX_WRITE_BUFFER_BYTES (1 << 20)  // Buffer de stdio al escribir un merge de runs
 
-// Estructura de una posición en el archivo
-typedef struct PosNode {
-    long pos;
-    struct PosNode *next;
-} PosNode;
+// Formato en disco de index_<emoción>.bin (todo little-endian, alineado a 8):
+//   [IndexFileHeader]
+//   [IndexArousalEntry x AROUSAL_LEVELS]   directorio de arousal
+//   [IndexArtistEntry x artist_count]      artistas ordenados por id dentro de cada arousal
+//   [bytes x postings_size]                posiciones de cada artista, ordenadas por offset
+//                                          y comprimidas con delta + Stream VByte (postings.h)
+// Los artistas se identifican por su id en el diccionario global (artists.bin).
+// El servidor lo mapea con mmap y decodifica solo la lista que se consulta.
+#define INDEX_MAGIC "MUSEIDX"
+#define INDEX_VERSION 3
 
-// Nodo de artista con su lista de posiciones
-typedef struct ArtistNode {
-    char artist[MAX_FIELD];
-    PosNode *positions;
-    struct ArtistNode *next;
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t arousal_levels;
+    uint64_t artist_count;
+    uint64_t position_count;
+    uint64_t artists_offset;
+    uint64_t postings_offset;
+    uint64_t postings_size;
+    uint64_t file_size;
+    uint64_t dictionary_id;   // Diccionario de artistas con el que se escribió
+} IndexFileHeader;
+
+// manifest.bin: estado de la indexación incremental.
+// Los segmentos delta index_<emoción>.<k>.bin (k = 1..segment_count) tienen el mismo
+// formato que la base y solo contienen las filas agregadas al CSV después de ella.
+#define INDEX_MANIFEST_FILE "manifest.bin"
+#define INDEX_MANIFEST_MAGIC "MUSEMAN"
+#define INDEX_MANIFEST_VERSION 1
+#define INDEX_PREFIX_BYTES (64 * 1024)  // Bytes del CSV que se comparan para detectar reescrituras
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t segment_count;   // Segmentos delta sobre la base
+    uint64_t dictionary_id;
+    uint64_t indexed_bytes;   // Bytes del CSV ya indexados (las filas nuevas empiezan aquí)
+    uint64_t prefix_hash;     // Hash de los primeros bytes del CSV al indexarlo
+    uint64_t rows;
+} IndexManifest;
+
+typedef struct {
+    uint32_t first_artist;    // Índice en la tabla de artistas
+    uint32_t artist_count;
+} IndexArousalEntry;
+
+typedef struct {
+    uint32_t artist_id;       // Id en el diccionario global de artistas
+    uint32_t position_count;
+    uint32_t data_offset;     // Relativo a postings_offset
+    uint32_t data_size;       // Bytes de la lista codificada
+} IndexArtistEntry;
+
+// Posiciones de un artista en el CSV: arreglo contiguo ordenado por offset.
+// Crece duplicando su capacidad dentro de la arena de la emoción.
+typedef struct {
+    int64_t *items;
+    uint32_t count;
+    uint32_t capacity;
+} PostingList;
+
+// Casilla de artista con su lista de posiciones (ARTIST_ID_NONE = vacía)
+typedef struct {
+    uint32_t artist_id;
+    uint32_t hash;            // artist_id_hash(artist_id): ocupa el relleno, evita recalcularlo al sondear
+    PostingList positions;
 } ArtistNode;
 
-// Índice por arousal: tabla hash de artistas
+// Índice por arousal: tabla hash de artistas por id, con direccionamiento
+// abierto, sondeo lineal y ubicación Robin Hood. Crece al doble según el factor de carga.
 typedef struct {
-    ArtistNode *buckets[MAX_ARTIST_BUCKETS];
+    ArtistNode *slots;
+    uint32_t slot_count;      // 0 o potencia de 2
+    uint32_t count;
 } ArousalIndex;
 
-// Índice por emoción: contiene los niveles de arousal
+// Índice por emoción: contiene los niveles de arousal.
+// El indexador usa `arousals` para construirlo; el servidor usa la vista mapeada.
+// Todos los nodos de construcción viven en `arena` y se liberan de una sola vez.
 typedef struct EmotionIndex {
     char emotion[MAX_FIELD];
     ArousalIndex *arousals;
+    Arena arena;
+
+    void *map;
+    size_t map_size;
+    const IndexFileHeader *header;
+    const IndexArousalEntry *arousal_dir;
+    const IndexArtistEntry *artist_table;
+    const uint8_t *postings;
+    struct EmotionIndex *next_segment;  // Segmento delta siguiente (servidor), o NULL
+
     struct EmotionIndex *next;
 } EmotionIndex;
 
-// Estructura para pasar a cada hilo
+// Índice parcial de un hilo: se construye sin locks sobre su rango de líneas
+// y después se mezcla con el global. Los artistas tienen ids locales.
+typedef struct {
+    EmotionIndex *emotions;     // Lista propia (enlazada por next)
+    ArtistDictBuilder artists;  // Ids locales por orden de aparición en el rango
+    uint32_t *global_ids;       // Id global de cada id local (se llena al mezclar)
+    long rows;                  // Filas indexadas en este parcial
+    uint64_t end;               // Fin (offset en el CSV) del último bloque indexado
+    int failed;                 // Faltó memoria al agregar una posición: el parcial está incompleto
+} PartialIndex;
+
+// Estructura para pasar a cada hilo parser del pipeline
 typedef struct {
     int id;
-    char **lines;
-    long *positions;
-    long num_lines;
+    struct IndexPipeline *pipeline;
+    long num_lines;           // Líneas recorridas (lo completa el hilo)
 } ThreadArgs;
 
 // Estructura que representa una canción (puedes usarla si la necesitas en otras partes del programa)
@@ -62,28 +159,125 @@ typedef struct {
     double dominance_tags;
 } Song;
 
+// CSV mapeado en memoria de solo lectura
+typedef struct {
+    const char *data;
+    size_t size;
+} MappedCsv;
+
+// Cantidad que responde el servidor cuando está saturado (en vez de la cantidad de canciones)
+#define SEARCH_BUSY (-1L)
+
 // Variable global que contiene la cabeza del índice
 extern EmotionIndex *emotion_index_head;
 
 // Mutex global para proteger acceso concurrente al índice
 extern pthread_mutex_t index_mutex;
 
-// Función principal para construir el índice
-void buildIndex(const char *filename);
+// Diccionario global de artistas usado al construir el índice
+extern ArtistDictBuilder artist_dict;
+
+// Presupuesto en bytes del índice en memoria al construir; al superarlo se vuelca
+// un run ordenado a disco. 0 = variable INDEX_MEMORY_MB o DEFAULT_INDEX_MEMORY_MB.
+extern size_t index_memory_budget;
+
+// Configuración del indexador en tiempo de ejecución (output/indexer la toma de sus
+// opciones). Se fijan antes de indexar; los valores por defecto son los de arriba.
+extern int index_threads;           // Hilos parser y de escritura (1..MAX_INDEX_THREADS)
+extern size_t index_chunk_bytes;    // Bytes del CSV por chunk
+extern char index_folder[256];      // Carpeta de índices, terminada en '/'
+
+// Cambia la carpeta de índices (agrega la '/' final si falta). Devuelve 0 si cabe.
+int set_index_folder(const char *path);
+
+// Función principal para construir el índice. Devuelve 0 si el índice y el manifest
+// quedaron escritos y las tablas hash pasaron el control de sondeo.
+int buildIndex(const char *filename);
+
+// Indexa solo las filas agregadas al CSV desde la última indexación, en un segmento
+// delta nuevo. Si no hay manifest o el CSV cambió por otro lado, reconstruye todo.
+// Devuelve 0 como buildIndex.
+int updateIndex(const char *filename);
+
+// Funde los segmentos delta de cada emoción en su archivo base. Devuelve 0 si quedaron
+// fundidos (o no había) y -1 si falló: en ese caso el manifest y los deltas no se tocan.
+int mergeIndexSegments(void);
 
 // Guarda el índice completo en disco
 void save_index_to_disk(void);
 
+// Guarda el índice en memoria como el segmento `segment` (0 = base). Devuelve -1 si
+// no se pudo escribir el diccionario o alguna emoción.
+int save_index_segment(uint32_t segment);
+
+// Ruta del segmento `segment` de una emoción
+void index_segment_path(char *buf, size_t size, const char *emotion, uint32_t segment);
+
+// Reconoce index_<emoción>.bin / index_<emoción>.<k>.bin. Devuelve 0 si el nombre coincide.
+int parse_index_file_name(const char *name, char *emotion, uint32_t *segment);
+
+// Lee / escribe manifest.bin. Devuelven 0 si todo salió bien.
+int read_index_manifest(IndexManifest *manifest);
+int write_index_manifest(const IndexManifest *manifest);
+
 // Sanitiza un string (deja solo letras en minúscula)
 void sanitize_input(char *str);
 
-// Hash para el nombre de un artista
-unsigned int hash_artist(const char *key);
-
 // Devuelve el índice de una emoción o lo crea si no existe
 EmotionIndex *get_or_create_emotion(const char *emotion);
 
-// Agrega una posición al índice para una emoción, arousal y artista dados
-void add_position(const char *emotion, int arousal, const char *artist, long pos);
+// Agrega una posición al índice para una emoción, arousal y artista dados.
+// Devuelve -1 si faltó memoria (la posición no quedó en el índice).
+int add_position(const char *emotion, int arousal, const char *artist, long pos);
+
+// Libera una emoción (su arena y su mapeo, si lo tiene)
+void free_emotion_index(EmotionIndex *eidx);
+
+// Libera el índice global completo
+void clear_index(void);
+
+// Imprime la memoria usada por las arenas del índice global
+void report_arena_usage(void);
+
+// Imprime el largo de sondeo de las tablas hash del índice global. Devuelve -1 si la
+// ubicación final de alguna supera los límites de hash_probe_check.
+int report_hash_stats(void);
+
+// Mapea un index_<emoción>.bin en memoria. Devuelve 0 si el archivo es válido.
+int map_emotion_index(EmotionIndex *eidx, const char *path);
+
+// Libera el mapeo creado por map_emotion_index
+void unmap_emotion_index(EmotionIndex *eidx);
+
+// Mapea la base y los segmentos 1..segment_count de una emoción como una cadena
+// (next_segment). Los que no existen se omiten; devuelve 0 si se mapeó al menos uno.
+int map_emotion_segments(EmotionIndex *eidx, const char *emotion, uint32_t segment_count);
+
+// Mapea el CSV completo (aviso de lectura secuencial). Devuelve 0 si se pudo abrir.
+int map_csv(const char *filename, MappedCsv *csv);
+
+// Libera el mapeo creado por map_csv
+void unmap_csv(MappedCsv *csv);
+
+// Bytes mapeados por toda la cadena de segmentos
+size_t emotion_index_size(const EmotionIndex *eidx);
+
+// Trae a memoria todas las páginas de un índice mapeado (para precargarlo)
+void prefault_emotion_index(const EmotionIndex *eidx);
+
+// Busca un artista (por id) en un arousal sobre el índice mapeado.
+// Devuelve su entrada (o NULL); position_count da la cantidad sin decodificar nada.
+const IndexArtistEntry *find_artist_entry(const EmotionIndex *eidx, int arousal, uint32_t artist_id);
+
+// Decodifica las posiciones de una entrada en `out` (espacio para position_count).
+// Devuelve 0 si la lista es válida.
+int decode_positions(const EmotionIndex *eidx, const IndexArtistEntry *entry, int64_t *out);
+
+// Cantidad de posiciones de un artista sumando todos los segmentos
+uint64_t count_positions(const EmotionIndex *eidx, int arousal, uint32_t artist_id);
+
+// Decodifica las posiciones de todos los segmentos en `out` (espacio para count_positions).
+// Los segmentos cubren rangos crecientes del CSV, así que el resultado queda ordenado.
+int collect_positions(const EmotionIndex *eidx, int arousal, uint32_t artist_id, int64_t *out);
 
 #endif
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "postings.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define POSTINGS_HAVE_SSSE3 1
+#endif
+
+// Cantidad de bytes de control de Stream VByte para n valores
+static size_t svb_control_bytes(uint32_t n) {
+    return (n + 3) / 4;
+}
+
+size_t posting_encoded_bound(uint32_t count) {
+    if (count == 0) return 0;
+    // Lo peor entre Stream VByte (4 bytes por delta) y el formato sin comprimir
+    size_t svb = 1 + 10 + svb_control_bytes(count - 1) + 4 * (size_t)(count - 1);
+    size_t raw = 1 + sizeof(int64_t) * (size_t)count;
+    return svb > raw ? svb : raw;
+}
+
+size_t posting_encode(const int64_t *positions, uint32_t count, uint8_t *out) {
+    if (count == 0) return 0;
+
+    for (uint32_t i = 1; i < count; i++) {
+        int64_t delta = positions[i] - positions[i - 1];
+        if (delta < 0 || delta > UINT32_MAX || positions[0] < 0) {
+            out[0] = POSTING_ENCODING_RAW;
+            memcpy(out + 1, positions, sizeof(int64_t) * count);
+            return 1 + sizeof(int64_t) * count;
+        }
+    }
+
+    uint8_t *p = out;
+    *p++ = POSTING_ENCODING_DELTA_SVB;
+
+    // Primera posición: varint de 7 bits por byte
+    uint64_t first = (uint64_t)positions[0];
+    while (first >= 0x80) {
+        *p++ = (uint8_t)(first | 0x80);
+        first >>= 7;
+    }
+    *p++ = (uint8_t)first;
+
+    uint32_t n = count - 1;
+    uint8_t *control = p;
+    uint8_t *data = control + svb_control_bytes(n);
+    memset(control, 0, svb_control_bytes(n));
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t delta = (uint32_t)(positions[i + 1] - positions[i]);
+        uint32_t len = delta < (1U << 8) ? 1 : delta < (1U << 16) ? 2 : delta < (1U << 24) ? 3 : 4;
+        control[i / 4] |= (uint8_t)((len - 1) << ((i % 4) * 2));
+        memcpy(data, &delta, len); // little-endian
+        data += len;
+    }
+    return (size_t)(data - out);
+}
+
+// ------------- DECODIFICACIÓN -------------
+
+static uint8_t svb_lengths[256];
+#ifdef POSTINGS_HAVE_SSSE3
+static uint8_t svb_shuffles[256][16];
+#endif
+static int svb_use_ssse3 = -1;
+static pthread_once_t svb_once = PTHREAD_ONCE_INIT;
+
+static void svb_init_tables(void) {
+    for (int c = 0; c < 256; c++) {
+        int offset = 0;
+        for (int v = 0; v < 4; v++) {
+            int len = ((c >> (v * 2)) & 3) + 1;
+#ifdef POSTINGS_HAVE_SSSE3
+            for (int b = 0; b < 4; b++)
+                svb_shuffles[c][v * 4 + b] = b < len ? (uint8_t)(offset + b) : 0x80;
+#endif
+            offset += len;
+        }
+        svb_lengths[c] = (uint8_t)offset;
+    }
+#ifdef POSTINGS_HAVE_SSSE3
+    __builtin_cpu_init();
+    svb_use_ssse3 = __builtin_cpu_supports("ssse3");
+#else
+    svb_use_ssse3 = 0;
+#endif
+}
+
+// Decodifica un valor suelto; devuelve los bytes consumidos o 0 si no alcanzan
+static size_t svb_decode_one(const uint8_t *data, const uint8_t *end, uint32_t code, uint32_t *value) {
+    uint32_t len = code + 1;
+    if ((size_t)(end - data) < len) return 0;
+    *value = 0;
+    memcpy(value, data, len);
+    return len;
+}
+
+#ifdef POSTINGS_HAVE_SSSE3
+// Decodifica grupos de 4 deltas con una sola instrucción de shuffle por byte de control.
+// Solo procesa grupos completos cuyos 16 bytes de lectura caben en el buffer.
+__attribute__((target("ssse3")))
+static uint32_t svb_decode_ssse3(const uint8_t *control, const uint8_t **data_ptr, const uint8_t *end,
+                                 uint32_t groups, uint32_t *out) {
+    const uint8_t *data = *data_ptr;
+    uint32_t g = 0;
+    for (; g < groups && end - data >= 16; g++) {
+        __m128i raw = _mm_loadu_si128((const __m128i *)data);
+        __m128i mask = _mm_loadu_si128((const __m128i *)svb_shuffles[control[g]]);
+        _mm_storeu_si128((__m128i *)(out + 4 * g), _mm_shuffle_epi8(raw, mask));
+        data += svb_lengths[control[g]];
+    }
+    *data_ptr = data;
+    return g;
+}
+#endif
+
+int posting_decode(const uint8_t *data, size_t size, uint32_t count, int64_t *out) {
+    if (count == 0) return size == 0 ? 0 : -1;
+    if (size < 2) return -1;
+
+    const uint8_t *end = data + size;
+    if (data[0] == POSTING_ENCODING_RAW) {
+        if (size != 1 + sizeof(int64_t) * (size_t)count) return -1;
+        memcpy(out, data + 1, sizeof(int64_t) * count);
+        return 0;
+    }
+    if (data[0] != POSTING_ENCODING_DELTA_SVB) return -1;
+
+    pthread_once(&svb_once, svb_init_tables);
+
+    const uint8_t *p = data + 1;
+    uint64_t first = 0;
+    for (int shift = 0;; shift += 7) {
+        if (p == end || shift > 63) return -1;
+        uint8_t byte = *p++;
+        first |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    out[0] = (int64_t)first;
+
+    uint32_t n = count - 1;
+    size_t control_size = svb_control_bytes(n);
+    if ((size_t)(end - p) < control_size) return -1;
+    const uint8_t *control = p;
+    p += control_size;
+
+    // Los deltas se decodifican como uint32 en la zona alta de `out` y luego
+    // se acumulan hacia adelante: la suma nunca pisa un delta sin leer.
+    uint32_t *deltas = (uint32_t *)(out + 1) + n;
+    uint32_t done = 0;
+#ifdef POSTINGS_HAVE_SSSE3
+    if (svb_use_ssse3)
+        done = 4 * svb_decode_ssse3(control, &p, end, n / 4, deltas);
+#endif
+    for (uint32_t i = done; i < n; i++) {
+        size_t used = svb_decode_one(p, end, (control[i / 4] >> ((i % 4) * 2)) & 3, &deltas[i]);
+        if (!used) return -1;
+        p += used;
+    }
+    if (p != end) return -1;
+
+    int64_t value = out[0];
+    for (uint32_t i = 0; i < n; i++) {
+        value += deltas[i];
+        out[i + 1] = value;
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Codificación de una lista de posiciones ordenada. El primer byte indica el formato:
+//   POSTING_ENCODING_DELTA_SVB: primera posición como varint de 64 bits, luego los
+//     deltas (32 bits) en formato Stream VByte: 2 bits de control por valor con su
+//     largo en bytes, seguidos de los bytes de datos
+//   POSTING_ENCODING_RAW: int64_t sin comprimir (si algún delta no cabe en 32 bits)
+#define POSTING_ENCODING_DELTA_SVB 1
+#define POSTING_ENCODING_RAW 2
+
+// Máximo de bytes que puede ocupar una lista de `count` posiciones codificada
+size_t posting_encoded_bound(uint32_t count);
+
+// Codifica `count` posiciones ordenadas en `out` (de al menos posting_encoded_bound bytes).
+// Devuelve los bytes escritos.
+size_t posting_encode(const int64_t *positions, uint32_t count, uint8_t *out);
+
+// Decodifica una lista en `out` (espacio para `count` posiciones).
+// Usa SSSE3 cuando la CPU lo soporta. Devuelve 0 si los datos son válidos.
+int posting_decode(const uint8_t *data, size_t size, uint32_t count, int64_t *out);
+
+#endif
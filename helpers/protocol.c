@@ -0,0 +1,229 @@
+#include <string.h>
+
+#include "protocol.h"
+
+// --- Escritura y lectura en orden de red ---
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+    return p + 4;
+}
+
+static uint8_t *put_u64(uint8_t *p, uint64_t v) {
+    p = put_u32(p, (uint32_t)(v >> 32));
+    return put_u32(p, (uint32_t)v);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    return (uint64_t)get_u32(p) << 32 | get_u32(p + 4);
+}
+
+static uint8_t *put_double(uint8_t *p, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return put_u64(p, bits);
+}
+
+// Texto como u8 largo + bytes; se corta en MAX_FIELD - 1 como los campos de Song
+static uint8_t *put_text(uint8_t *p, const char *text) {
+    size_t len = strnlen(text, MAX_FIELD - 1);
+    *p++ = (uint8_t)len;
+    memcpy(p, text, len);
+    return p + len;
+}
+
+// Cursor de lectura sobre el contenido de un mensaje; `bad` queda en 1 si se acaba
+typedef struct {
+    const uint8_t *p, *end;
+    int bad;
+} Reader;
+
+static const uint8_t *take(Reader *r, size_t n) {
+    if (r->bad || (size_t)(r->end - r->p) < n) {
+        r->bad = 1;
+        return NULL;
+    }
+    const uint8_t *at = r->p;
+    r->p += n;
+    return at;
+}
+
+static uint8_t take_u8(Reader *r) {
+    const uint8_t *p = take(r, 1);
+    return p ? *p : 0;
+}
+
+static uint32_t take_u32(Reader *r) {
+    const uint8_t *p = take(r, 4);
+    return p ? get_u32(p) : 0;
+}
+
+static double take_double(Reader *r) {
+    const uint8_t *p = take(r, 8);
+    uint64_t bits = p ? get_u64(p) : 0;
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static void take_text(Reader *r, char *dst) {
+    uint8_t len = take_u8(r);
+    const uint8_t *p = take(r, len);
+    if (!p || len >= MAX_FIELD) {
+        r->bad = 1;
+        dst[0] = '\0';
+        return;
+    }
+    memcpy(dst, p, len);
+    dst[len] = '\0';
+}
+
+// El cabezal se completa cuando se conoce el largo del contenido
+static uint8_t *begin_frame(uint8_t *out, int version, uint32_t id, uint8_t type) {
+    out[4] = type;
+    if (version >= 3) put_u32(out + 5, id);
+    return out + proto_header_bytes(version);
+}
+
+static size_t end_frame(uint8_t *out, int version, const uint8_t *p) {
+    size_t header = proto_header_bytes(version);
+    put_u32(out, (uint32_t)(p - out - header));
+    return (size_t)(p - out);
+}
+
+// --- Saludo y mensajes ---
+
+size_t proto_header_bytes(int version) {
+    return version >= 3 ? 9 : 5;
+}
+
+size_t proto_write_hello(uint8_t *out, uint8_t version) {
+    memcpy(out, PROTO_MAGIC, PROTO_MAGIC_BYTES);
+    out[PROTO_MAGIC_BYTES] = version;
+    return PROTO_HELLO_BYTES;
+}
+
+int proto_read_hello(const uint8_t *in, size_t avail, uint8_t *version) {
+    size_t cmp = avail < PROTO_MAGIC_BYTES ? avail : PROTO_MAGIC_BYTES;
+    if (memcmp(in, PROTO_MAGIC, cmp) != 0) return -1;
+    if (avail < PROTO_HELLO_BYTES) return 0;
+    *version = in[PROTO_MAGIC_BYTES];
+    return 1;
+}
+
+int proto_read_header(const uint8_t *in, int version, ProtoFrame *frame) {
+    frame->len = get_u32(in);
+    frame->type = in[4];
+    frame->id = version >= 3 ? get_u32(in + 5) : 0;
+    frame->payload = in + proto_header_bytes(version);
+    return frame->len > PROTO_MAX_PAYLOAD ? -1 : 0;
+}
+
+long proto_read_frame(const uint8_t *in, size_t avail, int version, ProtoFrame *frame) {
+    size_t header = proto_header_bytes(version);
+    if (avail < header) return 0;
+    if (proto_read_header(in, version, frame) != 0) return -1;
+    if (avail < header + frame->len) return 0;
+    return (long)(header + frame->len);
+}
+
+size_t proto_write_empty(uint8_t *out, int version, uint32_t id, uint8_t type) {
+    return end_frame(out, version, begin_frame(out, version, id, type));
+}
+
+size_t proto_write_search(uint8_t *out, int version, uint32_t id, const ProtoSearch *search) {
+    uint8_t *p = begin_frame(out, version, id, PROTO_MSG_SEARCH);
+    if (version >= 3) *p++ = search->options;
+    *p++ = (uint8_t)(search->arousal < 0 ? 0 : search->arousal > 255 ? 255 : search->arousal);
+    p = put_text(p, search->emotion);
+    p = put_text(p, search->artist);
+    if (version >= 3 && (search->options & PROTO_SEARCH_PAGE)) {
+        p = put_u32(p, search->offset);
+        p = put_u32(p, search->limit);
+    }
+    return end_frame(out, version, p);
+}
+
+size_t proto_write_confirm(uint8_t *out, int version, uint32_t id, int send_songs) {
+    uint8_t *p = begin_frame(out, version, id, PROTO_MSG_CONFIRM);
+    *p++ = send_songs ? 1 : 0;
+    return end_frame(out, version, p);
+}
+
+size_t proto_write_fetch(uint8_t *out, int version, uint32_t id, uint32_t offset, uint32_t limit) {
+    uint8_t *p = begin_frame(out, version, id, PROTO_MSG_FETCH);
+    p = put_u32(p, offset);
+    p = put_u32(p, limit);
+    return end_frame(out, version, p);
+}
+
+size_t proto_write_count(uint8_t *out, int version, uint32_t id, uint64_t count) {
+    return end_frame(out, version, put_u64(begin_frame(out, version, id, PROTO_MSG_COUNT), count));
+}
+
+size_t proto_write_song(uint8_t *out, int version, uint32_t id, const Song *song) {
+    uint8_t *p = begin_frame(out, version, id, PROTO_MSG_SONG);
+    p = put_text(p, song->lastfm_url);
+    p = put_text(p, song->track);
+    p = put_text(p, song->artist);
+    p = put_text(p, song->genre);
+    int seeds = song->seed_count < 0 ? 0 : song->seed_count > MAX_SEEDS ? MAX_SEEDS : song->seed_count;
+    *p++ = (uint8_t)seeds;
+    for (int i = 0; i < seeds; i++) p = put_text(p, song->seeds[i]);
+    p = put_double(p, song->number_of_emotions);
+    p = put_double(p, song->valence_tags);
+    p = put_double(p, song->arousal_tags);
+    p = put_double(p, song->dominance_tags);
+    return end_frame(out, version, p);
+}
+
+int proto_read_search(const ProtoFrame *frame, int version, ProtoSearch *search) {
+    Reader r = { frame->payload, frame->payload + frame->len, 0 };
+    search->options = version >= 3 ? take_u8(&r) : 0;
+    search->arousal = take_u8(&r);
+    take_text(&r, search->emotion);
+    take_text(&r, search->artist);
+    search->offset = search->limit = 0;
+    if (search->options & PROTO_SEARCH_PAGE) {
+        search->offset = take_u32(&r);
+        search->limit = take_u32(&r);
+    }
+    return r.bad || r.p != r.end ? -1 : 0;
+}
+
+int proto_read_fetch(const ProtoFrame *frame, uint32_t *offset, uint32_t *limit) {
+    if (frame->len != 8) return -1;
+    *offset = get_u32(frame->payload);
+    *limit = get_u32(frame->payload + 4);
+    return 0;
+}
+
+int proto_read_count(const ProtoFrame *frame, uint64_t *count) {
+    if (frame->len != 8) return -1;
+    *count = get_u64(frame->payload);
+    return 0;
+}
+
+int proto_read_song(const ProtoFrame *frame, Song *song) {
+    Reader r = { frame->payload, frame->payload + frame->len, 0 };
+    memset(song, 0, sizeof(*song));
+    take_text(&r, song->lastfm_url);
+    take_text(&r, song->track);
+    take_text(&r, song->artist);
+    take_text(&r, song->genre);
+    song->seed_count = take_u8(&r);
+    if (song->seed_count > MAX_SEEDS) return -1;
+    for (int i = 0; i < song->seed_count; i++) take_text(&r, song->seeds[i]);
+    song->number_of_emotions = take_double(&r);
+    song->valence_tags = take_double(&r);
+    song->arousal_tags = take_double(&r);
+    song->dominance_tags = take_double(&r);
+    return r.bad || r.p != r.end ? -1 : 0;
+}
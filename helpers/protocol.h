@@ -0,0 +1,107 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "indexador.h"
+
+// Protocolo de mensajes entre cliente y servidor (v2 y v3).
+//
+// El cliente abre la conexión con un saludo: PROTO_MAGIC seguido de un byte con la
+// versión más alta que entiende. El servidor responde lo mismo con la versión elegida.
+// Un cliente v1 empieza directamente con su petición (arousal como int de 0 a 100),
+// que nunca coincide con PROTO_MAGIC, así que el servidor sigue atendiéndolo igual.
+//
+// Después del saludo todo viaja en mensajes: largo del contenido (u32) + tipo (u8) +
+// [v3: id de la búsqueda (u32)] + contenido. Los enteros van en orden de red y los
+// textos como largo (u8) + bytes, sin '\0' ni relleno.
+//
+// v2 es de a una búsqueda por vez (búsqueda, cantidad, confirmación, canciones).
+// En v3 cada mensaje lleva el id que el cliente eligió para su búsqueda: el cliente
+// puede tener varias en curso en la misma conexión y las respuestas llegan
+// intercaladas, en el orden en que el servidor las termina. Una búsqueda v3 también
+// puede pedir solo la cantidad o una página de canciones (offset/limit); mientras
+// espera su confirmación, el cliente pide páginas con PROTO_MSG_FETCH y la cierra
+// con PROTO_MSG_CONFIRM.
+#define PROTO_MAGIC "MuSe"
+#define PROTO_MAGIC_BYTES 4
+#define PROTO_HELLO_BYTES (PROTO_MAGIC_BYTES + 1)
+#define PROTO_VERSION 3
+
+#define PROTO_MAX_HEADER_BYTES 9
+#define PROTO_MAX_PAYLOAD 2048 // Un mensaje más largo es un error de protocolo
+
+// Máximo de bytes de un mensaje PROTO_MSG_SONG (campos de MAX_FIELD - 1 bytes)
+#define PROTO_SONG_MAX_BYTES (PROTO_MAX_HEADER_BYTES + 1 + (4 + MAX_SEEDS) * MAX_FIELD + 4 * 8)
+#define PROTO_SEARCH_MAX_BYTES (PROTO_MAX_HEADER_BYTES + 2 + 2 * MAX_FIELD + 8)
+
+typedef enum {
+    PROTO_MSG_SEARCH = 1,  // Cliente: [v3: u8 opciones] u8 arousal, texto emoción, texto artista
+                           //          [PROTO_SEARCH_PAGE: u32 offset, u32 limit]
+    PROTO_MSG_CONFIRM = 2, // Cliente: u8 1 = enviar las canciones, 0 = omitirlas (cierra la búsqueda)
+    PROTO_MSG_COUNT = 3,   // Servidor: u64 canciones encontradas
+    PROTO_MSG_BUSY = 4,    // Servidor: saturado, la búsqueda no se atendió (sin contenido)
+    PROTO_MSG_SONG = 5,    // Servidor: una canción (ver proto_write_song)
+    PROTO_MSG_END = 6,     // Servidor: no hay más canciones de la búsqueda o página (sin contenido)
+    PROTO_MSG_FETCH = 7,   // Cliente (v3): u32 offset, u32 limit; la búsqueda sigue abierta
+} ProtoMessage;
+
+// Opciones de PROTO_MSG_SEARCH (v3)
+#define PROTO_SEARCH_SONGS 0x01      // Enviar las canciones tras la cantidad, sin esperar PROTO_MSG_CONFIRM
+#define PROTO_SEARCH_COUNT_ONLY 0x02 // Responder solo la cantidad y cerrar la búsqueda
+#define PROTO_SEARCH_PAGE 0x04       // Enviar solo las canciones [offset, offset + limit)
+
+// Búsqueda que envía el cliente. limit = 0 es "hasta la última canción".
+typedef struct {
+    uint8_t options;          // PROTO_SEARCH_* (v3)
+    int arousal;
+    char emotion[MAX_FIELD];
+    char artist[MAX_FIELD];
+    uint32_t offset, limit;   // Página (PROTO_SEARCH_PAGE)
+} ProtoSearch;
+
+// Mensaje recibido. `payload` apunta dentro de los datos leídos.
+typedef struct {
+    uint8_t type;
+    uint32_t id;              // Búsqueda a la que pertenece (0 antes de v3)
+    const uint8_t *payload;
+    uint32_t len;
+} ProtoFrame;
+
+// Bytes del cabezal de cada mensaje en la versión `version`
+size_t proto_header_bytes(int version);
+
+// Saludo con la versión `version`. Devuelve los bytes escritos (PROTO_HELLO_BYTES).
+size_t proto_write_hello(uint8_t *out, uint8_t version);
+
+// Lee un saludo de [in, in + avail). Devuelve 1 y la versión si está completo,
+// 0 si faltan bytes y -1 si los datos no empiezan con PROTO_MAGIC.
+int proto_read_hello(const uint8_t *in, size_t avail, uint8_t *version);
+
+// Lee el cabezal de un mensaje (proto_header_bytes). Devuelve -1 si el largo supera
+// PROTO_MAX_PAYLOAD.
+int proto_read_header(const uint8_t *in, int version, ProtoFrame *frame);
+
+// Separa el primer mensaje de [in, in + avail). Devuelve los bytes que ocupa si está
+// completo, 0 si faltan bytes y -1 si el largo supera PROTO_MAX_PAYLOAD.
+long proto_read_frame(const uint8_t *in, size_t avail, int version, ProtoFrame *frame);
+
+// Cada proto_write_* escribe un mensaje completo de la búsqueda `id` y devuelve sus bytes
+size_t proto_write_empty(uint8_t *out, int version, uint32_t id, uint8_t type);
+size_t proto_write_search(uint8_t *out, int version, uint32_t id, const ProtoSearch *search);
+size_t proto_write_confirm(uint8_t *out, int version, uint32_t id, int send_songs);
+size_t proto_write_fetch(uint8_t *out, int version, uint32_t id, uint32_t offset, uint32_t limit);
+size_t proto_write_count(uint8_t *out, int version, uint32_t id, uint64_t count);
+// `out` debe tener PROTO_SONG_MAX_BYTES: url, track, artist y genre como textos,
+// u8 cantidad de seeds y cada una como texto, y los cuatro tags como double (IEEE 754)
+size_t proto_write_song(uint8_t *out, int version, uint32_t id, const Song *song);
+
+// Cada proto_read_* interpreta el contenido de un mensaje. Devuelven 0 si es válido.
+// Los textos se copian terminados en '\0' (campos de MAX_FIELD bytes).
+int proto_read_search(const ProtoFrame *frame, int version, ProtoSearch *search);
+int proto_read_fetch(const ProtoFrame *frame, uint32_t *offset, uint32_t *limit);
+int proto_read_count(const ProtoFrame *frame, uint64_t *count);
+int proto_read_song(const ProtoFrame *frame, Song *song);
+
+#endif
@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "song_cache.h"
+
+#define SONG_CACHE_MIN_BUCKETS 64
+
+// Canción compacta: los cuatro tags y, en `text`, url, track, artist, genre y las
+// seeds, cada uno terminado en '\0'
+typedef struct SongCacheEntry {
+    int64_t offset;
+    struct SongCacheEntry *hash_next;
+    struct SongCacheEntry *prev;  // Más reciente hacia el frente
+    struct SongCacheEntry *next;
+    size_t bytes;             // Lo que cuenta contra el presupuesto
+    double tags[4];
+    int seed_count;
+    char text[];
+} SongCacheEntry;
+
+static uint64_t hash_offset(int64_t offset) {
+    return (uint64_t)offset * 0x9E3779B97F4A7C15ULL;
+}
+
+static SongCacheShard *shard_of(SongCache *cache, uint64_t hash) {
+    return &cache->shards[(hash >> 32) % SONG_CACHE_SHARDS];
+}
+
+static char *pack_text(char *p, const char *text) {
+    size_t len = strnlen(text, MAX_FIELD - 1);
+    memcpy(p, text, len);
+    p[len] = '\0';
+    return p + len + 1;
+}
+
+static const char *unpack_text(const char *p, char *dst) {
+    size_t len = strlen(p);
+    memcpy(dst, p, len + 1);
+    return p + len + 1;
+}
+
+static SongCacheEntry *entry_pack(int64_t offset, const Song *song) {
+    int seeds = song->seed_count < 0 ? 0 : song->seed_count > MAX_SEEDS ? MAX_SEEDS : song->seed_count;
+    size_t text = strnlen(song->lastfm_url, MAX_FIELD - 1) + strnlen(song->track, MAX_FIELD - 1) +
+                  strnlen(song->artist, MAX_FIELD - 1) + strnlen(song->genre, MAX_FIELD - 1) + 4;
+    for (int i = 0; i < seeds; i++) text += strnlen(song->seeds[i], MAX_FIELD - 1) + 1;
+
+    SongCacheEntry *e = malloc(sizeof(SongCacheEntry) + text);
+    if (!e) return NULL;
+    e->offset = offset;
+    e->bytes = sizeof(SongCacheEntry) + text;
+    e->tags[0] = song->number_of_emotions;
+    e->tags[1] = song->valence_tags;
+    e->tags[2] = song->arousal_tags;
+    e->tags[3] = song->dominance_tags;
+    e->seed_count = seeds;
+    char *p = pack_text(e->text, song->lastfm_url);
+    p = pack_text(p, song->track);
+    p = pack_text(p, song->artist);
+    p = pack_text(p, song->genre);
+    for (int i = 0; i < seeds; i++) p = pack_text(p, song->seeds[i]);
+    return e;
+}
+
+// `song` ya viene en cero, igual que lo deja readSongAt
+static void entry_unpack(const SongCacheEntry *e, Song *song) {
+    const char *p = unpack_text(e->text, song->lastfm_url);
+    p = unpack_text(p, song->track);
+    p = unpack_text(p, song->artist);
+    p = unpack_text(p, song->genre);
+    song->seed_count = e->seed_count;
+    for (int i = 0; i < e->seed_count; i++) p = unpack_text(p, song->seeds[i]);
+    song->number_of_emotions = e->tags[0];
+    song->valence_tags = e->tags[1];
+    song->arousal_tags = e->tags[2];
+    song->dominance_tags = e->tags[3];
+}
+
+// Todas las funciones shard_* se llaman con el lock del shard tomado.
+
+static SongCacheEntry **shard_slot(SongCacheShard *s, uint64_t hash, int64_t offset) {
+    SongCacheEntry **slot = &s->buckets[(hash >> 8) & (s->bucket_count - 1)];
+    while (*slot && (*slot)->offset != offset) slot = &(*slot)->hash_next;
+    return slot;
+}
+
+static void shard_unlink(SongCacheShard *s, SongCacheEntry *e) {
+    if (e->prev) e->prev->next = e->next;
+    else s->head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else s->tail = e->prev;
+}
+
+static void shard_push_front(SongCacheShard *s, SongCacheEntry *e) {
+    e->prev = NULL;
+    e->next = s->head;
+    if (s->head) s->head->prev = e;
+    s->head = e;
+    if (!s->tail) s->tail = e;
+}
+
+// Duplica la tabla cuando hay más canciones que buckets. Si no hay memoria se sigue
+// con la tabla actual (solo se alargan las cadenas).
+static void shard_grow(SongCacheShard *s) {
+    size_t count = s->bucket_count ? s->bucket_count * 2 : SONG_CACHE_MIN_BUCKETS;
+    SongCacheEntry **buckets = calloc(count, sizeof(SongCacheEntry *));
+    if (!buckets) return;
+    for (size_t i = 0; i < s->bucket_count; i++) {
+        for (SongCacheEntry *e = s->buckets[i], *next; e; e = next) {
+            next = e->hash_next;
+            SongCacheEntry **slot = &buckets[(hash_offset(e->offset) >> 8) & (count - 1)];
+            e->hash_next = *slot;
+            *slot = e;
+        }
+    }
+    free(s->buckets);
+    s->buckets = buckets;
+    s->bucket_count = count;
+}
+
+void song_cache_init(SongCache *cache, size_t budget) {
+    memset(cache, 0, sizeof(*cache));
+    cache->budget = budget;
+    for (int i = 0; i < SONG_CACHE_SHARDS; i++) {
+        pthread_mutex_init(&cache->shards[i].lock, NULL);
+        cache->shards[i].budget = budget / SONG_CACHE_SHARDS;
+    }
+}
+
+int song_cache_get(SongCache *cache, int64_t offset, Song *song) {
+    if (cache->budget == 0) return 0;
+    uint64_t hash = hash_offset(offset);
+    SongCacheShard *s = shard_of(cache, hash);
+    memset(song, 0, sizeof(*song));
+
+    pthread_mutex_lock(&s->lock);
+    SongCacheEntry *e = s->bucket_count ? *shard_slot(s, hash, offset) : NULL;
+    if (e) {
+        shard_unlink(s, e);
+        shard_push_front(s, e);
+        entry_unpack(e, song);
+        s->hits++;
+    } else {
+        s->misses++;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return e != NULL;
+}
+
+void song_cache_put(SongCache *cache, int64_t offset, const Song *song) {
+    if (cache->budget == 0) return;
+    uint64_t hash = hash_offset(offset);
+    SongCacheShard *s = shard_of(cache, hash);
+    SongCacheEntry *e = entry_pack(offset, song); // Se arma fuera del lock
+    if (!e) return;
+    if (e->bytes > s->budget) {
+        free(e);
+        return;
+    }
+
+    // Las expulsadas se liberan después de soltar el lock
+    SongCacheEntry *evicted = NULL;
+    pthread_mutex_lock(&s->lock);
+    if (s->songs >= s->bucket_count) shard_grow(s);
+    SongCacheEntry **slot = s->bucket_count ? shard_slot(s, hash, offset) : NULL;
+    if (!slot || *slot) {
+        // Otro hilo ya la guardó mientras se leía del CSV (o no hay tabla)
+        pthread_mutex_unlock(&s->lock);
+        free(e);
+        return;
+    }
+    e->hash_next = NULL;
+    *slot = e;
+    shard_push_front(s, e);
+    s->songs++;
+    s->bytes += e->bytes;
+
+    while (s->bytes > s->budget && s->tail != e) {
+        SongCacheEntry *old = s->tail;
+        shard_unlink(s, old);
+        SongCacheEntry **old_slot = shard_slot(s, hash_offset(old->offset), old->offset);
+        *old_slot = old->hash_next;
+        s->songs--;
+        s->bytes -= old->bytes;
+        s->evictions++;
+        old->next = evicted;
+        evicted = old;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    while (evicted) {
+        SongCacheEntry *next = evicted->next;
+        free(evicted);
+        evicted = next;
+    }
+}
+
+void song_cache_stats(SongCache *cache, SongCacheStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->budget = cache->budget;
+    for (int i = 0; i < SONG_CACHE_SHARDS; i++) {
+        SongCacheShard *s = &cache->shards[i];
+        pthread_mutex_lock(&s->lock);
+        stats->songs += s->songs;
+        stats->bytes += s->bytes;
+        stats->hits += s->hits;
+        stats->misses += s->misses;
+        stats->evictions += s->evictions;
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+void song_cache_destroy(SongCache *cache) {
+    for (int i = 0; i < SONG_CACHE_SHARDS; i++) {
+        SongCacheShard *s = &cache->shards[i];
+        for (SongCacheEntry *e = s->head, *next; e; e = next) {
+            next = e->next;
+            free(e);
+        }
+        free(s->buckets);
+        pthread_mutex_destroy(&s->lock);
+    }
+    memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,60 @@
+#ifndef SONG_CACHE_H
+#define SONG_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "indexador.h"
+
+#define SONG_CACHE_SHARDS 16 // Cada shard tiene su lock, su tabla y su lista LRU
+
+struct SongCacheEntry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    struct SongCacheEntry **buckets; // Tabla hash por offset (encadenada)
+    size_t bucket_count;
+    struct SongCacheEntry *head;     // Más recientemente usada
+    struct SongCacheEntry *tail;     // Menos recientemente usada
+    size_t songs;
+    size_t bytes;
+    size_t budget;
+    long hits;
+    long misses;
+    long evictions;
+} SongCacheShard;
+
+// Caché LRU de canciones ya parseadas, por offset de su línea en el CSV. Las canciones
+// se guardan compactas (textos sin el relleno de Song), así que el presupuesto rinde
+// ~10 veces más que con structs Song. Los hilos que buscan offsets distintos casi
+// nunca comparten shard.
+typedef struct {
+    SongCacheShard shards[SONG_CACHE_SHARDS];
+    size_t budget;            // 0 = caché desactivada
+} SongCache;
+
+typedef struct {
+    size_t songs;
+    size_t bytes;
+    size_t budget;
+    long hits;
+    long misses;
+    long evictions;
+} SongCacheStats;
+
+// Prepara una caché de hasta `budget` bytes (repartidos entre los shards)
+void song_cache_init(SongCache *cache, size_t budget);
+
+// Copia en `song` la canción del offset. Devuelve 1 si estaba y 0 si no.
+int song_cache_get(SongCache *cache, int64_t offset, Song *song);
+
+// Guarda la canción del offset y expulsa las menos usadas que no entren
+void song_cache_put(SongCache *cache, int64_t offset, const Song *song);
+
+// Suma los contadores de todos los shards
+void song_cache_stats(SongCache *cache, SongCacheStats *stats);
+
+void song_cache_destroy(SongCache *cache);
+
+#endif
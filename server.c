@@ -6,300 +6,1234 @@
 #include <signal.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <ctype.h>
 #include <time.h>
 #include <pthread.h> // NUEVO: Librería para hilos
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "./helpers/indexador.h"
+#include "./helpers/protocol.h"
+#include "./helpers/song_cache.h"
 
 // #define PORT 3550 // MODIFICADO: El puerto ahora será dinámico
-#define BACKLOG 10 // Aumentado un poco para entornos de producción
+#define BACKLOG 512 // Cola de conexiones pendientes: el reactor acepta en ráfagas
+#define MAX_EVENTS 64 // Eventos que devuelve cada epoll_wait
+#define REQUEST_BYTES (sizeof(int) + 2 * MAX_FIELD) // Petición v1: arousal + emoción + artista
+#define CONN_IN_BYTES 4096 // Buffer de entrada por conexión
+#define CONN_OUT_HIGH_WATER (64 * 1024) // Salida pendiente a partir de la cual no se generan más respuestas
+#define SONG_BATCH 16 // Canciones que lee el pool por trabajo
+#define MAX_CONN_REQUESTS 32 // Búsquedas en curso por conexión (v3); las de más se responden ocupado
+#define DEFAULT_WORK_QUEUE_SIZE 256 // Trabajos en espera del pool (WORK_QUEUE_SIZE)
+#define DEFAULT_QUEUE_DEADLINE_MS 2000 // Espera máxima de una búsqueda con la cola llena (QUEUE_DEADLINE_MS)
+#define PARKED_POLL_MS 10 // Reintento de los trabajos que esperan lugar en la cola
+#define DEFAULT_INDEX_CACHE_MB 512 // Presupuesto de la caché de índices (INDEX_CACHE_MB)
+#define DEFAULT_SONG_CACHE_MB 64 // Presupuesto de la caché de canciones (SONG_CACHE_MB, 0 = sin caché)
+
+
+// Entrada de la caché compartida de índices por emoción.
+// `refs` cuenta los lectores activos más una referencia propia de la caché
+// mientras la entrada está en la lista LRU; el índice se desmapea cuando llega a 0.
+typedef struct CacheEntry {
+    char emotion[MAX_FIELD];
+    EmotionIndex *index;      // NULL mientras se carga o si la carga falló
+    size_t bytes;
+    int refs;
+    int loading;
+    struct CacheEntry *prev;  // Más reciente hacia el frente
+    struct CacheEntry *next;
+} CacheEntry;
 
-// Estructura para pasar argumentos al hilo del cliente
-// NUEVO: Necesitamos pasar tanto el socket como la ruta al CSV
 typedef struct {
-    int client_socket;
-    char csv_path[256];
-} client_args_t;
+    pthread_mutex_t lock;
+    pthread_cond_t loaded;    // Señala el fin de una carga (single-flight)
+    CacheEntry *head;         // Más recientemente usada
+    CacheEntry *tail;         // Menos recientemente usada
+    size_t bytes;
+    size_t budget;
+    long hits;
+    long misses;
+    long evictions;
+} IndexCache;
+
+// Diccionario global de artistas, mapeado una sola vez al arrancar
+static ArtistDictionary artist_dictionary;
+
+// Segmentos delta vigentes según manifest.bin al arrancar
+static uint32_t index_segments;
+
+static IndexCache index_cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .loaded = PTHREAD_COND_INITIALIZER,
+    .budget = (size_t)DEFAULT_INDEX_CACHE_MB << 20,
+};
 
+// Canciones ya parseadas por offset en el CSV, compartida por los hilos del pool
+static SongCache song_cache;
 
-// --- Declaraciones de funciones ---
-void *handle_client(void *args); // NUEVO: Función que manejará cada cliente
+// CSV mapeado una sola vez al arrancar: los hilos del pool leen las líneas
+// directamente de las páginas mapeadas, sin FILE ni buffers propios
+static MappedCsv songs_csv;
 
 // --- Código del Servidor ---
 
+// Abre el índice binario de una emoción (base y segmentos delta) con mmap. No hay
+// deserialización: las búsquedas se responden directamente sobre las páginas mapeadas.
 EmotionIndex *loadEmotionIndex(const char *emotion) {
-    char path[256];
-    snprintf(path, sizeof(path), "%sindex_%s.bin", INDEX_FOLDER, emotion);
-    FILE *file = fopen(path, "rb");
-    if (!file) {
-        perror("[loadEmotionIndex] No se pudo abrir archivo binario");
-        return NULL;
-    }
-
-    EmotionIndex *eidx = malloc(sizeof(EmotionIndex));
+    EmotionIndex *eidx = calloc(1, sizeof(EmotionIndex));
     if (!eidx) {
         perror("malloc");
-        fclose(file);
         return NULL;
     }
     strncpy(eidx->emotion, emotion, MAX_FIELD-1);
-    eidx->emotion[MAX_FIELD - 1] = '\0'; 
-    eidx->arousals = calloc(101, sizeof(ArousalIndex));
-    eidx->next = emotion_index_head;
-    emotion_index_head = eidx;
-
-    for (int i = 0; i <= 100; i++) {
-        int artist_count;
-        if (fread(&artist_count, sizeof(int), 1, file) != 1) {
-            fprintf(stderr, "[loadEmotionIndex] Error leyendo count arousal %d\n", i);
-            fclose(file);
+    eidx->emotion[MAX_FIELD - 1] = '\0';
+
+    if (map_emotion_segments(eidx, emotion, index_segments) != 0) {
+        free_emotion_index(eidx);
+        return NULL;
+    }
+
+    // Los ids de artista solo tienen sentido con el diccionario con el que se escribió
+    for (const EmotionIndex *seg = eidx; seg; seg = seg->next_segment) {
+        if (seg->header->dictionary_id != artist_dictionary.header->dictionary_id) {
+            fprintf(stderr, "[loadEmotionIndex] '%s' no corresponde al diccionario de artistas cargado\n", emotion);
+            free_emotion_index(eidx);
             return NULL;
         }
+    }
 
-        for (int j = 0; j < artist_count; j++) {
-            int len;
-            if (fread(&len, sizeof(int), 1, file) != 1) break;
-
-            char artist[MAX_FIELD];
-            if (fread(artist, sizeof(char), len, file) != len) break;
-            artist[len] = '\0';
-
-            unsigned int h = hash_artist(artist);
-            ArtistNode *an = malloc(sizeof(ArtistNode));
-            strncpy(an->artist, artist, MAX_FIELD - 1);
-            an->artist[MAX_FIELD - 1] = '\0';
-            an->positions = NULL;
-            an->next = eidx->arousals[i].buckets[h];
-            eidx->arousals[i].buckets[h] = an;
-
-            int pos_count;
-            if (fread(&pos_count, sizeof(int), 1, file) != 1) {
-                fprintf(stderr, "Error leyendo cantidad de posiciones\n");
-                fclose(file);
-                return NULL;
-            }
+    printf("[loadEmotionIndex] Índice mapeado correctamente para '%s' (%zu bytes)\n", emotion, emotion_index_size(eidx));
+    return eidx;
+}
 
-            for (int k = 0; k < pos_count; k++) {
-                long p;
-                if (fread(&p, sizeof(long), 1, file) != 1) {
-                    fprintf(stderr, "Error leyendo cantidad de posiciones\n");
-                    fclose(file);
-                    return NULL;
-                }
-
-                PosNode *pn = malloc(sizeof(PosNode));
-                pn->pos = p;
-                pn->next = an->positions;
-                an->positions = pn;
-            }
+// ------------- CACHÉ COMPARTIDA DE ÍNDICES -------------
+// Todas las funciones cache_* se llaman con index_cache.lock tomado.
+
+static void cache_unlink(CacheEntry *e) {
+    if (e->prev) e->prev->next = e->next;
+    else index_cache.head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else index_cache.tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void cache_push_front(CacheEntry *e) {
+    e->prev = NULL;
+    e->next = index_cache.head;
+    if (index_cache.head) index_cache.head->prev = e;
+    index_cache.head = e;
+    if (!index_cache.tail) index_cache.tail = e;
+}
+
+// Suelta una referencia. Devuelve el índice a liberar (fuera del lock) si era la última.
+static EmotionIndex *cache_put(CacheEntry *e) {
+    if (--e->refs > 0) return NULL;
+    EmotionIndex *eidx = e->index;
+    free(e);
+    return eidx;
+}
+
+// Saca de la caché las entradas menos usadas hasta respetar el presupuesto.
+// Las entradas en uso por otros hilos solo se desmapean cuando su último lector las suelta.
+static void cache_evict(EmotionIndex **to_free, int max_free, int *n_free) {
+    CacheEntry *e = index_cache.tail;
+    while (e && e != index_cache.head && index_cache.bytes > index_cache.budget) {
+        CacheEntry *prev = e->prev;
+        if (!e->loading && *n_free < max_free) {
+            cache_unlink(e);
+            index_cache.bytes -= e->bytes;
+            index_cache.evictions++;
+            printf("[cache] Expulsando '%s' (%zu bytes)\n", e->emotion, e->bytes);
+            to_free[(*n_free)++] = cache_put(e);
         }
+        e = prev;
     }
+}
 
-    fclose(file);
-    printf("[loadEmotionIndex] Índice cargado correctamente para '%s'\n", emotion);
-    return eidx;
+// Devuelve una entrada con el índice de la emoción y una referencia tomada,
+// o NULL si el índice no existe. Si varios hilos piden la misma emoción fría,
+// solo uno la carga y el resto espera a que termine.
+CacheEntry *acquireEmotionIndex(const char *emotion) {
+    pthread_mutex_lock(&index_cache.lock);
+
+    CacheEntry *e;
+    for (e = index_cache.head; e; e = e->next)
+        if (strcmp(e->emotion, emotion) == 0) break;
+
+    if (e) {
+        e->refs++;
+        cache_unlink(e);
+        cache_push_front(e);
+        if (e->loading) {
+            while (e->loading) pthread_cond_wait(&index_cache.loaded, &index_cache.lock);
+        } else {
+            index_cache.hits++;
+        }
+
+        EmotionIndex *to_free = NULL;
+        if (!e->index) {
+            to_free = cache_put(e);
+            e = NULL;
+        }
+        pthread_mutex_unlock(&index_cache.lock);
+        free_emotion_index(to_free);
+        return e;
+    }
+
+    // Fallo: se registra la entrada como "cargando" y se carga fuera del lock
+    e = calloc(1, sizeof(CacheEntry));
+    if (!e) {
+        pthread_mutex_unlock(&index_cache.lock);
+        perror("malloc");
+        return NULL;
+    }
+    snprintf(e->emotion, sizeof(e->emotion), "%s", emotion);
+    e->refs = 2; // Este lector + la caché
+    e->loading = 1;
+    cache_push_front(e);
+    index_cache.misses++;
+    pthread_mutex_unlock(&index_cache.lock);
+
+    EmotionIndex *eidx = loadEmotionIndex(emotion);
+
+    EmotionIndex *to_free[16];
+    int n_free = 0;
+
+    pthread_mutex_lock(&index_cache.lock);
+    e->loading = 0;
+    e->index = eidx;
+    if (eidx) {
+        e->bytes = emotion_index_size(eidx);
+        index_cache.bytes += e->bytes;
+        cache_evict(to_free, 16, &n_free);
+        printf("[cache] %zu/%zu MB en uso (aciertos: %ld, fallos: %ld, expulsiones: %ld)\n",
+               index_cache.bytes >> 20, index_cache.budget >> 20,
+               index_cache.hits, index_cache.misses, index_cache.evictions);
+    } else {
+        // No se guardan cargas fallidas: la próxima consulta lo reintenta
+        cache_unlink(e);
+        e->refs--;
+        to_free[n_free++] = cache_put(e);
+        e = NULL;
+    }
+    pthread_cond_broadcast(&index_cache.loaded);
+    pthread_mutex_unlock(&index_cache.lock);
+
+    for (int i = 0; i < n_free; i++) free_emotion_index(to_free[i]);
+    return e;
 }
 
-void clearEmotionIndex() {
-    EmotionIndex *curr = emotion_index_head;
-    while (curr) {
-        EmotionIndex *to_free = curr;
-        curr = curr->next;
-
-        if (to_free->arousals) {
-            for (int i = 0; i <= 100; i++) {
-                ArousalIndex *ai = &to_free->arousals[i];
-                for (int b = 0; b < MAX_ARTIST_BUCKETS; b++) {
-                    ArtistNode *artist = ai->buckets[b];
-                    while (artist) {
-                        ArtistNode *next_artist = artist->next;
-
-                        PosNode *pos = artist->positions;
-                        while (pos) {
-                            PosNode *next_pos = pos->next;
-                            free(pos);
-                            pos = next_pos;
-                        }
-
-                        free(artist);
-                        artist = next_artist;
-                    }
-                }
-            }
-            free(to_free->arousals);
+void releaseEmotionIndex(CacheEntry *e) {
+    if (!e) return;
+    pthread_mutex_lock(&index_cache.lock);
+    EmotionIndex *to_free = cache_put(e);
+    pthread_mutex_unlock(&index_cache.lock);
+    free_emotion_index(to_free);
+}
+
+// ------------- PRECARGA DE ÍNDICES -------------
+
+typedef struct {
+    char emotion[MAX_FIELD];
+    off_t size;
+} PreloadItem;
+
+typedef struct {
+    PreloadItem *items;
+    int count;
+    int next;                 // Siguiente emoción a cargar (protegido por lock)
+    int loaded;
+    pthread_mutex_t lock;
+} PreloadQueue;
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static int compare_preload_by_size(const void *a, const void *b) {
+    off_t x = ((const PreloadItem *)a)->size, y = ((const PreloadItem *)b)->size;
+    return (x < y) - (x > y); // De mayor a menor
+}
+
+// Lista las emociones con índice en disco. Devuelve la cantidad o -1.
+static int list_index_emotions(PreloadItem **out) {
+    DIR *dir = opendir(index_folder);
+    if (!dir) {
+        perror("[preload] No se pudo abrir la carpeta de índices");
+        return -1;
+    }
+
+    int count = 0, capacity = 64;
+    PreloadItem *items = malloc(sizeof(PreloadItem) * capacity);
+    struct dirent *de;
+    while (items && (de = readdir(dir)) != NULL) {
+        // Una entrada por emoción: los segmentos delta se cargan junto con su base
+        char emotion[MAX_FIELD];
+        uint32_t segment;
+        if (parse_index_file_name(de->d_name, emotion, &segment) != 0 || segment != 0) continue;
+
+        if (count == capacity) {
+            capacity *= 2;
+            PreloadItem *grown = realloc(items, sizeof(PreloadItem) * capacity);
+            if (!grown) break;
+            items = grown;
+        }
+
+        PreloadItem *item = &items[count];
+        memcpy(item->emotion, emotion, MAX_FIELD);
+
+        char path[PATH_MAX];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s%s", index_folder, de->d_name);
+        item->size = stat(path, &st) == 0 ? st.st_size : 0;
+        count++;
+    }
+    closedir(dir);
+
+    if (!items) {
+        perror("malloc");
+        return -1;
+    }
+    *out = items;
+    return count;
+}
+
+static void *preload_worker(void *arg) {
+    PreloadQueue *queue = arg;
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        int i = queue->next < queue->count ? queue->next++ : -1;
+        pthread_mutex_unlock(&queue->lock);
+        if (i < 0) break;
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        CacheEntry *entry = acquireEmotionIndex(queue->items[i].emotion);
+        if (entry) {
+            prefault_emotion_index(entry->index);
+            releaseEmotionIndex(entry); // La caché conserva su propia referencia
+            pthread_mutex_lock(&queue->lock);
+            queue->loaded++;
+            pthread_mutex_unlock(&queue->lock);
+        }
+        printf("[preload] '%s' %s en %.1f ms\n", queue->items[i].emotion,
+               entry ? "listo" : "falló", elapsed_ms(&start));
+    }
+    return NULL;
+}
+
+// Carga índices en la caché antes de aceptar clientes.
+// spec: "all", "top:N" (los N archivos más grandes) o una lista "emo1,emo2,...".
+void preloadIndexes(const char *spec) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    PreloadQueue queue = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    if (strcmp(spec, "all") == 0 || strncmp(spec, "top:", 4) == 0) {
+        queue.count = list_index_emotions(&queue.items);
+        if (queue.count < 0) return;
+        qsort(queue.items, queue.count, sizeof(PreloadItem), compare_preload_by_size);
+        if (spec[0] == 't' && atoi(spec + 4) >= 0 && atoi(spec + 4) < queue.count)
+            queue.count = atoi(spec + 4);
+    } else {
+        int capacity = 1;
+        for (const char *c = spec; *c; c++) if (*c == ',') capacity++;
+        queue.items = calloc(capacity, sizeof(PreloadItem));
+        if (!queue.items) {
+            perror("malloc");
+            return;
         }
 
-        free(to_free);
+        char *list = strdup(spec), *save = NULL;
+        for (char *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+            snprintf(queue.items[queue.count].emotion, MAX_FIELD, "%s", tok);
+            sanitize_input(queue.items[queue.count].emotion);
+            if (queue.items[queue.count].emotion[0]) queue.count++;
+        }
+        free(list);
     }
-    emotion_index_head = NULL;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = cpus > 0 ? (int)cpus : 1;
+    if (workers > queue.count) workers = queue.count;
+    printf("[preload] Precargando %d índices con %d hilos...\n", queue.count, workers);
+
+    pthread_t *threads = malloc(sizeof(pthread_t) * (workers ? workers : 1));
+    int started = 0;
+    for (int i = 0; threads && i < workers; i++)
+        if (pthread_create(&threads[started], NULL, preload_worker, &queue) == 0) started++;
+    if (started == 0) preload_worker(&queue);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    free(threads);
+
+    pthread_mutex_lock(&index_cache.lock);
+    size_t cached = index_cache.bytes;
+    pthread_mutex_unlock(&index_cache.lock);
+    printf("[preload] %d/%d índices cargados en %.1f ms (%zu MB en caché de %zu MB)\n",
+           queue.loaded, queue.count, elapsed_ms(&start), cached >> 20, index_cache.budget >> 20);
+    if (index_cache.evictions > 0)
+        printf("[preload] ⚠️ La precarga superó INDEX_CACHE_MB: se expulsaron %ld índices\n", index_cache.evictions);
+
+    free(queue.items);
 }
 
-Song readSongAt(FILE *file, long pos) {
+// Parsea la canción cuya línea empieza en `pos`. Solo lee del mapeo (no hay estado
+// compartido), así que los hilos del pool la llaman en paralelo sin locks.
+Song readSongAt(const MappedCsv *csv, long pos) {
     Song song = {0};
-    if (fseek(file, pos, SEEK_SET) != 0) {
-        perror("Error al posicionar archivo");
+    if (pos < 0 || (size_t)pos >= csv->size) {
+        fprintf(stderr, "Error al posicionar archivo: %ld fuera del CSV\n", pos);
         return song;
     }
-    
-    char line[LINE_BUFFER];
-    if (!fgets(line, sizeof(line), file)) {
-        return song;
+
+    // Igual que con fgets, la línea se corta en LINE_BUFFER - 1 bytes
+    const char *line = csv->data + pos;
+    size_t avail = csv->size - (size_t)pos;
+    if (avail > LINE_BUFFER - 1) avail = LINE_BUFFER - 1;
+    const char *end = memchr(line, '\n', avail);
+    if (!end) end = line + avail;
+    const char *cr = memchr(line, '\r', (size_t)(end - line));
+    if (cr) end = cr;
+
+    // Mismo tokenizador que usa el indexador (helpers/csv.h)
+    CsvSpan tokens[NUM_FIELDS];
+    csv_split_fields(line, end, tokens, NUM_FIELDS);
+
+    // Asignar los campos a la estructura Song
+    csv_span_copy(song.lastfm_url, sizeof(song.lastfm_url), &tokens[0]);
+    csv_span_copy(song.track, sizeof(song.track), &tokens[1]);
+    csv_span_copy(song.artist, sizeof(song.artist), &tokens[2]);
+
+    // Cada emoción del campo seeds va entre comillas simples
+    const char *p_seeds = tokens[3].start;
+    const char *seeds_end = tokens[3].start + tokens[3].len;
+    while (song.seed_count < MAX_SEEDS && (p_seeds = memchr(p_seeds, '\'', seeds_end - p_seeds)) != NULL) {
+        p_seeds++; // Mover el puntero más allá de la comilla de apertura
+        const char *end_quote = memchr(p_seeds, '\'', seeds_end - p_seeds);
+        if (!end_quote) break; // Si no hay comilla de cierre, la línea está mal formada
+
+        CsvSpan seed = { p_seeds, (size_t)(end_quote - p_seeds) };
+        csv_span_copy(song.seeds[song.seed_count++], MAX_FIELD, &seed);
+
+        // Avanzamos el puntero para la siguiente búsqueda
+        p_seeds = end_quote + 1;
     }
 
-    // Misma lógica de buildIndex para el parseo
-    char *p_line = line;
-    char *tokens[NUM_FIELDS] = {0};
-    for (int i = 0; i < NUM_FIELDS; i++) {
-        char *start = p_line;
+    song.number_of_emotions = csv_span_atof(&tokens[4]);
+    song.valence_tags = csv_span_atof(&tokens[5]);
+    song.arousal_tags = csv_span_atof(&tokens[6]);
+    song.dominance_tags = csv_span_atof(&tokens[7]);
+
+    // El género es el último campo; el salto de línea ya quedó fuera del tramo
+    csv_span_copy(song.genre, sizeof(song.genre), &tokens[11]);
+
+    return song;
+}
+
+// readSongAt pasando por la caché de canciones: las canciones populares (las mismas
+// búsquedas de muchos clientes) se sirven sin volver a tokenizar la línea
+static Song readCachedSongAt(long pos) {
+    Song song;
+    if (song_cache_get(&song_cache, pos, &song)) return song;
+    song = readSongAt(&songs_csv, pos);
+    if (song.lastfm_url[0]) song_cache_put(&song_cache, pos, &song); // Las lecturas fallidas no se guardan
+    return song;
+}
+
+// Informa los contadores de la caché de canciones si hubo lecturas desde el último informe
+static void song_cache_report(void) {
+    static long reported;
+    SongCacheStats stats;
+    song_cache_stats(&song_cache, &stats);
+    long lookups = stats.hits + stats.misses;
+    if (lookups == reported) return;
+    reported = lookups;
+    printf("[songs] %zu canciones, %zu/%zu MB (aciertos: %ld, fallos: %ld, %.0f%%, expulsiones: %ld)\n",
+           stats.songs, stats.bytes >> 20, stats.budget >> 20, stats.hits, stats.misses,
+           100.0 * stats.hits / lookups, stats.evictions);
+}
+
+// ------------- REACTOR (EPOLL) Y POOL DE TRABAJO -------------
+// Un solo hilo atiende todas las conexiones con sockets no bloqueantes. Cada búsqueda
+// es una máquina de estados búsqueda -> confirmación -> canciones, así que un cliente
+// ocioso (o un humano pensando si responder 'y') solo ocupa sus buffers.
+// El protocolo se detecta con los primeros bytes: un saludo PROTO_MAGIC pasa la
+// conexión a mensajes v2/v3 (helpers/protocol.h); cualquier otra cosa es una petición
+// v1 de structs crudos, que se sigue atendiendo para los clientes anteriores. v1 y v2
+// tienen una búsqueda por vez; en v3 el cliente puede tener hasta MAX_CONN_REQUESTS en
+// curso, identificadas por su id, y sus respuestas se intercalan mensaje a mensaje.
+// Lo que consume CPU o disco (buscar en el índice, decodificar posiciones, leer y
+// parsear canciones del CSV) lo hace un pool fijo de hilos que toma búsquedas de una
+// cola acotada; el reactor se entera de cada trabajo terminado por un eventfd.
+
+typedef enum {
+    REQ_LOOKUP,               // Buscando en el índice (trabajo del pool)
+    REQ_WAIT_CONFIRM,         // Se envió la cantidad; esperando la confirmación
+    REQ_STREAM,               // Enviando canciones (se piden por lotes a medida que se vacía la salida)
+} RequestState;
+
+typedef enum {
+    JOB_NONE,
+    JOB_LOOKUP,               // Resolver el artista, tomar el índice y contar posiciones
+    JOB_SONGS,                // Decodificar posiciones (la primera vez) y leer un lote de canciones
+} JobKind;
+
+// Política ante una cola de trabajo llena (OVERLOAD_POLICY)
+typedef enum {
+    OVERLOAD_DEADLINE,        // Esperar en la cola; si vence el plazo, responder ocupado
+    OVERLOAD_REJECT,          // Responder ocupado de inmediato
+} OverloadPolicy;
+
+struct Connection;
+
+// Búsqueda en curso de una conexión
+typedef struct Request {
+    struct Connection *conn;
+    struct Request *next_active;  // Siguiente búsqueda de la misma conexión, en orden de llegada
+    uint32_t id;              // Id que eligió el cliente (v3; 0 en v1/v2)
+    ProtoSearch query;        // Lo que pidió el cliente (v1/v2: sin opciones ni página)
+    RequestState state;
+
+    // Trabajo en curso. Mientras job != JOB_NONE solo el hilo del pool toca los
+    // campos de la búsqueda; el resultado se publica con el lock de la cola.
+    JobKind job;
+    int expired;              // La búsqueda venció en la cola: se responde ocupado
+    int may_busy;             // Búsqueda nueva que admite "ocupado" (v2/v3): tiene plazo o se rechaza
+    struct timespec deadline; // Plazo de una búsqueda en la cola (OVERLOAD_DEADLINE)
+    struct Request *next_parked;
+
+    CacheEntry *entry;
+    uint32_t artist_id;
+    long found;
+    int64_t *positions;
+    long next;                // Siguiente canción a leer
+    long page_end;            // Fin (exclusivo) de las canciones que se envían
+    int fetching;             // La página la pidió un PROTO_MSG_FETCH: después se esperan más pedidos
+    int pages;                // Páginas enviadas por PROTO_MSG_FETCH
+    Song *batch;              // Lote leído por el pool, pendiente de encolar
+    int batch_count;
+} Request;
+
+typedef struct Connection {
+    int fd;
+    int protocol;             // 0 = aún sin detectar, 1 = structs crudos, 2-3 = mensajes
+    uint32_t events;          // Eventos registrados en epoll
+    int closed;               // El cliente se fue con trabajos en curso: se libera al terminar
+
+    char in[CONN_IN_BYTES];
+    size_t in_len;
+
+    char *out;                // Pendiente de enviar: out[out_off, out_len)
+    size_t out_off, out_len, out_cap;
+
+    Request *requests;        // Búsquedas en curso
+    int active;               // Cuántas hay
+    int jobs;                 // Cuántas tiene el pool o esperan lugar en su cola
+    int ready;                // Tiene respuestas del pool sin enviar (está en ready_conns)
+    struct Connection *next_ready;
+    struct Connection *next_closed;
+} Connection;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    Request **queue;          // Cola circular acotada de búsquedas con trabajo
+    int capacity, head, count;
+    Request *done;            // Trabajos terminados (enlazados por next_parked)
+    int eventfd;              // Despierta al reactor cuando hay trabajos terminados
+    int workers;
+    OverloadPolicy policy;
+    long deadline_ms;
+} WorkPool;
+
+static WorkPool work_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .ready = PTHREAD_COND_INITIALIZER,
+    .eventfd = -1,
+};
+
+// Búsquedas que no entraron en la cola llena (solo las toca el reactor), en orden de llegada
+static Request *parked_head, *parked_tail;
+
+// Conexiones cerradas que se liberan al terminar la vuelta del bucle de eventos:
+// epoll_wait pudo haber devuelto más eventos para ellas en la misma tanda
+static Connection *closed_conns;
+
+// Conexiones con respuestas del pool ya encoladas: se envían al terminar de aplicar
+// toda la tanda de trabajos, con un solo send por conexión
+static Connection *ready_conns;
+
+static size_t conn_pending(const Connection *c) {
+    return c->out_len - c->out_off;
+}
 
-        while (*p_line && *p_line != ','){
-            if(*p_line == '['){
-                while (*p_line && *p_line != ']') p_line++;
+static int conn_queue(Connection *c, const void *data, size_t size) {
+    if (c->out_off == c->out_len) c->out_off = c->out_len = 0;
+    if (c->out_len + size > c->out_cap) {
+        // Primero se compacta lo ya enviado; si no alcanza, se agranda
+        if (c->out_off > 0) {
+            memmove(c->out, c->out + c->out_off, conn_pending(c));
+            c->out_len -= c->out_off;
+            c->out_off = 0;
+        }
+        if (c->out_len + size > c->out_cap) {
+            size_t cap = c->out_cap ? c->out_cap : 4096;
+            while (cap < c->out_len + size) cap *= 2;
+            char *grown = realloc(c->out, cap);
+            if (!grown) {
+                perror("realloc");
+                return -1;
             }
-            if (*p_line) p_line++;
+            c->out = grown;
+            c->out_cap = cap;
         }
-        
-        if (*p_line) {
-            *p_line = '\0';
-            p_line++;
+    }
+    memcpy(c->out + c->out_len, data, size);
+    c->out_len += size;
+    return 0;
+}
+
+// Agrega una búsqueda al final de las de la conexión
+static Request *request_start(Connection *c, uint32_t id) {
+    Request *r = calloc(1, sizeof(Request));
+    if (!r) {
+        perror("malloc");
+        return NULL;
+    }
+    r->conn = c;
+    r->id = id;
+    r->state = REQ_LOOKUP;
+    Request **link = &c->requests;
+    while (*link) link = &(*link)->next_active;
+    *link = r;
+    c->active++;
+    return r;
+}
+
+static Request *request_find(Connection *c, uint32_t id) {
+    Request *r = c->requests;
+    while (r && r->id != id) r = r->next_active;
+    return r;
+}
+
+// Suelta la búsqueda y la saca de su conexión
+static void request_end(Request *r) {
+    Connection *c = r->conn;
+    Request **link = &c->requests;
+    while (*link != r) link = &(*link)->next_active;
+    *link = r->next_active;
+    c->active--;
+
+    releaseEmotionIndex(r->entry);
+    free(r->positions);
+    free(r->batch);
+    free(r);
+}
+
+// --- Trabajo del pool (fuera del hilo del reactor) ---
+
+static void job_lookup(Request *r) {
+    ProtoSearch *q = &r->query;
+    // Los campos llegan de la red (ya terminados en '\0'): se sanitizan antes de usarlos como ruta
+    printf("[Cliente %d] Búsqueda: Arousal=%d, Emotion='%s', Artist='%s'\n", r->conn->fd, q->arousal, q->emotion, q->artist);
+    sanitize_input(q->emotion);
+    sanitize_input(q->artist);
+
+    // El artista se resuelve a su id una sola vez; el resto son comparaciones de enteros
+    r->artist_id = artist_dictionary_find(&artist_dictionary, q->artist);
+
+    // Tomar el índice de la caché compartida (lo carga si hace falta).
+    // La referencia mantiene el mapeo vivo hasta terminar de enviar resultados.
+    r->entry = acquireEmotionIndex(q->emotion);
+
+    // Buscar en el índice mapeado: la cantidad sale de las entradas, sin decodificar
+    EmotionIndex *eidx = r->entry ? r->entry->index : NULL;
+    r->found = (long)count_positions(eidx, q->arousal, r->artist_id);
+}
+
+// Lee el siguiente lote de la página [next, page_end). Solo se leen del CSV las
+// canciones que se van a enviar.
+static void job_songs(Request *r) {
+    // Solo se descomprime la lista cuando el cliente pide canciones; las páginas
+    // siguientes de la misma búsqueda la reusan
+    if (!r->positions) {
+        r->positions = malloc(sizeof(int64_t) * r->found);
+        if (!r->positions) {
+            perror("malloc");
+            r->found = 0;
+        } else if (collect_positions(r->entry->index, r->query.arousal, r->artist_id, r->positions) != 0) {
+            fprintf(stderr, "[Cliente %d] Lista de posiciones corrupta para '%s'\n", r->conn->fd, r->entry->emotion);
+            r->found = 0;
         }
-        tokens[i] = start;
     }
-    
-    // Asignar los campos a la estructura Song
-    if (tokens[0]) snprintf(song.lastfm_url, sizeof(song.lastfm_url), "%s", tokens[0]);
-    if (tokens[1]) snprintf(song.track, sizeof(song.track), "%s", tokens[1]);
-    if (tokens[2]) snprintf(song.artist, sizeof(song.artist), "%s", tokens[2]);
-
-    if (tokens[3]) {
-        char *p_seeds = tokens[3];
-        while ((p_seeds = strchr(p_seeds, '\'')) != NULL && song.seed_count < MAX_SEEDS) {
-            p_seeds++; // Mover el puntero más allá de la comilla de apertura
-            char *end_quote = strchr(p_seeds, '\'');
-            if (!end_quote) break; // Si no hay comilla de cierre, la línea está mal formada
-
-            // Guardamos el carácter original y ponemos un terminador nulo para copiar
-            char original_char = *end_quote;
-            *end_quote = '\0';
-
-            // Copiamos la emoción encontrada
-            snprintf(song.seeds[song.seed_count++], MAX_FIELD, "%s", p_seeds);
-            
-            // Restauramos el carácter original para no alterar el resto del parseo
-            *end_quote = original_char;
-
-            // Avanzamos el puntero para la siguiente búsqueda
-            p_seeds = end_quote + 1;
+
+    if (!r->batch) r->batch = malloc(sizeof(Song) * SONG_BATCH);
+    r->batch_count = 0;
+    if (!r->batch || r->found == 0) {
+        r->next = r->page_end; // No se pueden leer canciones: solo se envía el terminador
+        return;
+    }
+    while (r->batch_count < SONG_BATCH && r->next < r->page_end)
+        r->batch[r->batch_count++] = readCachedSongAt(r->positions[r->next++]);
+}
+
+static int deadline_passed(const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+static void *pool_worker(void *arg) {
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&work_pool.lock);
+        while (work_pool.count == 0) pthread_cond_wait(&work_pool.ready, &work_pool.lock);
+        Request *r = work_pool.queue[work_pool.head];
+        work_pool.head = (work_pool.head + 1) % work_pool.capacity;
+        work_pool.count--;
+        pthread_mutex_unlock(&work_pool.lock);
+
+        // Una búsqueda que esperó más que su plazo ya no se atiende: el cliente recibe "ocupado"
+        if (r->may_busy && work_pool.policy == OVERLOAD_DEADLINE && deadline_passed(&r->deadline))
+            r->expired = 1;
+        else if (r->job == JOB_LOOKUP) job_lookup(r);
+        else job_songs(r);
+
+        pthread_mutex_lock(&work_pool.lock);
+        r->next_parked = work_pool.done;
+        work_pool.done = r;
+        pthread_mutex_unlock(&work_pool.lock);
+        uint64_t one = 1;
+        if (write(work_pool.eventfd, &one, sizeof(one)) < 0 && errno != EAGAIN) perror("[pool] eventfd");
+    }
+    return NULL;
+}
+
+static int pool_start(void) {
+    const char *workers_str = getenv("WORKER_THREADS");
+    const char *queue_str = getenv("WORK_QUEUE_SIZE");
+    const char *deadline_str = getenv("QUEUE_DEADLINE_MS");
+    const char *policy_str = getenv("OVERLOAD_POLICY");
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    work_pool.workers = workers_str && atoi(workers_str) > 0 ? atoi(workers_str) : (cpus > 0 ? (int)cpus : 1);
+    work_pool.capacity = queue_str && atoi(queue_str) > 0 ? atoi(queue_str) : DEFAULT_WORK_QUEUE_SIZE;
+    work_pool.deadline_ms = deadline_str && atol(deadline_str) > 0 ? atol(deadline_str) : DEFAULT_QUEUE_DEADLINE_MS;
+    work_pool.policy = policy_str && strcmp(policy_str, "reject") == 0 ? OVERLOAD_REJECT : OVERLOAD_DEADLINE;
+    work_pool.queue = calloc(work_pool.capacity, sizeof(Request *));
+    work_pool.eventfd = eventfd(0, EFD_NONBLOCK);
+    if (!work_pool.queue || work_pool.eventfd < 0) return -1;
+
+    int started = 0;
+    for (int i = 0; i < work_pool.workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, pool_worker, NULL) == 0) {
+            pthread_detach(thread);
+            started++;
         }
     }
+    if (started == 0) return -1;
+    work_pool.workers = started;
 
-    if (tokens[4]) song.number_of_emotions = atof(tokens[4]);
-    if (tokens[5]) song.valence_tags = atof(tokens[5]);
-    if (tokens[6]) song.arousal_tags = atof(tokens[6]);
-    if (tokens[7]) song.dominance_tags = atof(tokens[7]);
-    
-    // El token de género es el último, puede contener el salto de línea
-    if (tokens[11]) {
-        snprintf(song.genre, sizeof(song.genre), "%s", tokens[11]);
-        song.genre[strcspn(song.genre, "\r\n")] = 0;
+    if (work_pool.policy == OVERLOAD_REJECT)
+        printf("🧵 Pool de %d hilos, cola de %d trabajos (llena: rechazar)\n", work_pool.workers, work_pool.capacity);
+    else
+        printf("🧵 Pool de %d hilos, cola de %d trabajos (llena: esperar hasta %ld ms)\n",
+               work_pool.workers, work_pool.capacity, work_pool.deadline_ms);
+    return 0;
+}
+
+// Intenta pasar la búsqueda a la cola del pool. Devuelve 0 si entró.
+static int pool_try_submit(Request *r) {
+    pthread_mutex_lock(&work_pool.lock);
+    int ok = work_pool.count < work_pool.capacity;
+    if (ok) {
+        work_pool.queue[(work_pool.head + work_pool.count++) % work_pool.capacity] = r;
+        pthread_cond_signal(&work_pool.ready);
     }
+    pthread_mutex_unlock(&work_pool.lock);
+    return ok ? 0 : -1;
+}
 
-    return song;
+// --- Respuestas en el protocolo de la conexión ---
+
+static void request_send_count(Request *r, long found) {
+    Connection *c = r->conn;
+    if (c->protocol == 1) {
+        conn_queue(c, &found, sizeof(long));
+        return;
+    }
+    uint8_t msg[PROTO_MAX_HEADER_BYTES + 8];
+    size_t size = found == SEARCH_BUSY ? proto_write_empty(msg, c->protocol, r->id, PROTO_MSG_BUSY)
+                                       : proto_write_count(msg, c->protocol, r->id, (uint64_t)found);
+    conn_queue(c, msg, size);
 }
 
-// NUEVO: Toda la lógica de manejo de un cliente se mueve a esta función.
-// Cada cliente tendrá su propia instancia de esta función ejecutándose en un hilo.
-void *handle_client(void *args) {
-    client_args_t *client_data = (client_args_t *)args;
-    int clientfd = client_data->client_socket;
-    const char *csv_path = client_data->csv_path;
-    
-    printf("🧵 Hilo creado para manejar al cliente con socket FD: %d\n", clientfd);
+static void request_send_song(Request *r, const Song *song) {
+    Connection *c = r->conn;
+    if (c->protocol == 1) {
+        conn_queue(c, song, sizeof(Song));
+        return;
+    }
+    uint8_t msg[PROTO_SONG_MAX_BYTES];
+    conn_queue(c, msg, proto_write_song(msg, c->protocol, r->id, song));
+}
 
-    char prev_emotion[MAX_FIELD] = "";
+// Fin de las canciones: v1 lo marca con un Song vacío
+static void request_send_end(Request *r) {
+    Connection *c = r->conn;
+    if (c->protocol == 1) {
+        Song terminator = {0};
+        conn_queue(c, &terminator, sizeof(Song));
+        return;
+    }
+    uint8_t msg[PROTO_MAX_HEADER_BYTES];
+    conn_queue(c, msg, proto_write_empty(msg, c->protocol, r->id, PROTO_MSG_END));
+}
 
-    // Bucle de comunicación con este cliente específico
-    while (1) {
-        int arousal;
-        char emotion[MAX_FIELD];
-        char artist[MAX_FIELD];
-
-        // Recibir datos de búsqueda del cliente
-        ssize_t bytes_received;
-        bytes_received = recv(clientfd, &arousal, sizeof(int), 0);
-        if (bytes_received <= 0) break;
-
-        bytes_received = recv(clientfd, emotion, sizeof(emotion), 0);
-        if (bytes_received <= 0) break;
-
-        bytes_received = recv(clientfd, artist, sizeof(artist), 0);
-        if (bytes_received <= 0) break;
-        
-        printf("[Hilo %d] Búsqueda: Arousal=%d, Emotion='%s', Artist='%s'\n", clientfd, arousal, emotion, artist);
-
-        // Cargar índice si es necesario
-        // NOTA: La carga del índice no es segura para hilos (thread-safe) si múltiples
-        // hilos intentan modificar `emotion_index_head` al mismo tiempo. Para esta
-        // práctica, asumimos que las búsquedas de nuevas emociones son infrecuentes.
-        // En un sistema real, se necesitaría un mutex (un cerrojo). -> Será una acción futura.
-        if (strcmp(prev_emotion, emotion) != 0) {
-            clearEmotionIndex(); // ¡CUIDADO! Esto no es thread-safe.
-            loadEmotionIndex(emotion);
-            snprintf(prev_emotion, MAX_FIELD, "%s", emotion);
+// Solo para búsquedas con may_busy: v1 no tiene cómo decir "ocupado"
+static void request_busy(Request *r) {
+    request_send_count(r, SEARCH_BUSY);
+    request_end(r);
+}
+
+// Encarga un trabajo. Con la cola llena, una búsqueda nueva se rechaza (OVERLOAD_REJECT)
+// o espera su turno en el reactor hasta el plazo; un envío ya empezado siempre espera.
+// v1 no tiene respuesta "ocupado" (un -1 en la cantidad desincroniza a los clientes
+// anteriores, que igual envían la confirmación), así que sus búsquedas esperan sin plazo.
+static void request_submit(Request *r, JobKind kind) {
+    r->job = kind;
+    r->expired = 0;
+    r->may_busy = kind == JOB_LOOKUP && r->conn->protocol >= 2;
+    if (r->may_busy) {
+        clock_gettime(CLOCK_MONOTONIC, &r->deadline);
+        r->deadline.tv_sec += work_pool.deadline_ms / 1000;
+        r->deadline.tv_nsec += (work_pool.deadline_ms % 1000) * 1000000L;
+        if (r->deadline.tv_nsec >= 1000000000L) {
+            r->deadline.tv_sec++;
+            r->deadline.tv_nsec -= 1000000000L;
         }
-        
-        // Buscar en el índice
-        EmotionIndex* eidx = emotion_index_head;
-        ArousalIndex* ai = (eidx && arousal >= 0 && arousal <= 100) ? &eidx->arousals[arousal] : NULL;
-        unsigned int h = hash_artist(artist);
-        ArtistNode* an = ai ? ai->buckets[h] : NULL;
-        while(an && strcmp(an->artist, artist) != 0) an = an->next;
-
-        long found = 0;
-        PosNode* positions_head = an ? an->positions : NULL;
-        for (PosNode* pn = positions_head; pn; pn = pn->next) found++;
-
-        send(clientfd, &found, sizeof(long), 0);
-
-        if (found > 0) {
-            char confirm;
-            if (recv(clientfd, &confirm, 1, 0) <= 0 || confirm != 'y') {
-                printf("[Hilo %d] El cliente no quiere ver los resultados.\n", clientfd);
-                continue;
-            }
-            
-            FILE *songs_file = fopen(csv_path, "r");
-            if (!songs_file) {
-                perror("[Hilo] Error abriendo CSV");
-                continue;
-            }
+    }
+    // Las que esperan lugar van primero, salvo que la búsqueda se rechace si no entra
+    int reject = r->may_busy && work_pool.policy == OVERLOAD_REJECT;
+    if ((!parked_head || reject) && pool_try_submit(r) == 0) {
+        r->conn->jobs++;
+        return;
+    }
 
-            for (PosNode* pn = positions_head; pn; pn = pn->next) {
-                Song s = readSongAt(songs_file, pn->pos);
-                send(clientfd, &s, sizeof(Song), 0);
-            }
-            
-            Song terminator = {0};
-            send(clientfd, &terminator, sizeof(Song), 0);
-            fclose(songs_file);
+    if (reject) {
+        r->job = JOB_NONE;
+        request_busy(r);
+        return;
+    }
+    r->conn->jobs++;
+    r->next_parked = NULL;
+    if (parked_tail) parked_tail->next_parked = r;
+    else parked_head = r;
+    parked_tail = r;
+}
+
+// Saca una búsqueda de la lista de espera. Devuelve 0 si no estaba.
+static int parked_remove(Request *r) {
+    Request **link = &parked_head, *prev = NULL;
+    while (*link && *link != r) prev = *link, link = &(*link)->next_parked;
+    if (!*link) return 0;
+    *link = r->next_parked;
+    if (parked_tail == r) parked_tail = prev;
+    return 1;
+}
+
+// --- Reactor ---
+
+// v3 siempre lee: una confirmación puede venir detrás de búsquedas que no tienen
+// lugar (y que se responden ocupado). v1/v2 leen cuando no hay búsqueda o cuando la
+// única espera su confirmación.
+static int conn_accepts_input(const Connection *c) {
+    return c->protocol >= 3 || c->active == 0 || c->requests->state == REQ_WAIT_CONFIRM;
+}
+
+// Bytes de la siguiente unidad completa de la entrada (saludo, petición o confirmación),
+// 0 si faltan datos o -1 si el cliente no respeta el protocolo
+static long conn_next_input(const Connection *c) {
+    const uint8_t *in = (const uint8_t *)c->in;
+    uint8_t version;
+    ProtoFrame frame;
+    if (c->protocol == 0) {
+        int hello = proto_read_hello(in, c->in_len, &version);
+        if (hello >= 0) return hello ? PROTO_HELLO_BYTES : 0;
+    }
+    if (c->protocol >= 2) return proto_read_frame(in, c->in_len, c->protocol, &frame);
+    size_t need = c->active == 0 ? REQUEST_BYTES : 1;
+    return c->in_len >= need ? (long)need : 0;
+}
+
+// Primera búsqueda que envía canciones y no tiene un lote en curso
+static Request *conn_next_stream(const Connection *c) {
+    Request *r = c->requests;
+    while (r && (r->state != REQ_STREAM || r->job != JOB_NONE)) r = r->next_active;
+    return r;
+}
+
+// Hay canciones por pedir o una unidad completa en la entrada que se puede atender
+static int conn_has_work(const Connection *c) {
+    return conn_next_stream(c) || (conn_accepts_input(c) && conn_next_input(c) != 0);
+}
+
+// Terminó de enviar una página: la búsqueda espera otro pedido (PROTO_MSG_FETCH) o se cierra
+static void request_page_done(Request *r) {
+    request_send_end(r);
+    if (r->fetching) {
+        r->state = REQ_WAIT_CONFIRM;
+        r->pages++;
+    } else {
+        request_end(r);
+    }
+}
+
+// Empieza a enviar las canciones [offset, offset + limit) (limit = 0: hasta la última)
+static void request_page(Request *r, uint32_t offset, uint32_t limit, int fetching) {
+    r->next = (long)offset < r->found ? (long)offset : r->found;
+    r->page_end = limit > 0 && r->next + (long)limit < r->found ? r->next + (long)limit : r->found;
+    r->fetching = fetching;
+    r->state = REQ_STREAM;
+    if (r->next >= r->page_end) request_page_done(r);
+}
+
+// Pide las canciones (1) u omite los resultados (0)
+static void request_confirm(Request *r, int send_songs) {
+    if (send_songs) {
+        request_page(r, r->query.offset, r->query.limit, 0);
+    } else {
+        if (r->pages == 0) printf("[Cliente %d] El cliente no quiere ver los resultados.\n", r->conn->fd);
+        request_end(r);
+    }
+}
+
+// Atiende la unidad de `used` bytes al principio de la entrada. Devuelve -1 si no es
+// válida en el estado actual.
+static int conn_handle_input(Connection *c, long used) {
+    const uint8_t *in = (const uint8_t *)c->in;
+    uint8_t version;
+    Request *r;
+    if (c->protocol == 0 && proto_read_hello(in, used, &version) == 1) {
+        // Se acuerda la menor de las dos versiones; un saludo v1 sigue con structs crudos
+        if (version == 0) return -1;
+        c->protocol = version < PROTO_VERSION ? version : PROTO_VERSION;
+        uint8_t reply[PROTO_HELLO_BYTES];
+        conn_queue(c, reply, proto_write_hello(reply, (uint8_t)c->protocol));
+        printf("[Cliente %d] Protocolo v%d\n", c->fd, c->protocol);
+        return 0;
+    }
+    if (c->protocol == 0) c->protocol = 1;
+
+    if (c->protocol == 1) {
+        if (c->active > 0) {
+            request_confirm(c->requests, c->in[0] == 'y');
+            return 0;
+        }
+        if (!(r = request_start(c, 0))) return -1;
+        memcpy(&r->query.arousal, c->in, sizeof(int));
+        memcpy(r->query.emotion, c->in + sizeof(int), MAX_FIELD);
+        memcpy(r->query.artist, c->in + sizeof(int) + MAX_FIELD, MAX_FIELD);
+        r->query.emotion[MAX_FIELD - 1] = '\0';
+        r->query.artist[MAX_FIELD - 1] = '\0';
+        request_submit(r, JOB_LOOKUP);
+        return 0;
+    }
+
+    ProtoFrame frame;
+    proto_read_frame(in, (size_t)used, c->protocol, &frame);
+    r = request_find(c, frame.id);
+    if (frame.type == PROTO_MSG_SEARCH && !r && c->active >= MAX_CONN_REQUESTS) {
+        uint8_t msg[PROTO_MAX_HEADER_BYTES];
+        conn_queue(c, msg, proto_write_empty(msg, c->protocol, frame.id, PROTO_MSG_BUSY));
+    } else if (frame.type == PROTO_MSG_SEARCH && !r && (c->protocol >= 3 || c->active == 0)) {
+        ProtoSearch query;
+        if (proto_read_search(&frame, c->protocol, &query) != 0 || !(r = request_start(c, frame.id)))
+            return -1;
+        r->query = query;
+        request_submit(r, JOB_LOOKUP);
+    } else if (frame.type == PROTO_MSG_CONFIRM && r && r->state == REQ_WAIT_CONFIRM && frame.len == 1) {
+        request_confirm(r, frame.payload[0] != 0);
+    } else if (frame.type == PROTO_MSG_FETCH && r && r->state == REQ_WAIT_CONFIRM) {
+        uint32_t offset, limit;
+        if (proto_read_fetch(&frame, &offset, &limit) != 0) return -1;
+        request_page(r, offset, limit, 1);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Avanza las búsquedas con la entrada acumulada y pide lotes de canciones por turno.
+// Un cliente que no lee sus respuestas deja de ser atendido hasta que la salida baje
+// de CONN_OUT_HIGH_WATER. Devuelve -1 si el cliente rompió el protocolo.
+static int conn_process(Connection *c) {
+    while (conn_pending(c) < CONN_OUT_HIGH_WATER) {
+        Request *r = conn_next_stream(c);
+        if (r) {
+            request_submit(r, JOB_SONGS);
+            continue;
+        }
+
+        long used = conn_accepts_input(c) ? conn_next_input(c) : 0;
+        if (used == 0) break;
+        if (used < 0 || conn_handle_input(c, used) != 0) {
+            printf("[Cliente %d] ❌ Mensaje inválido: se cierra la conexión\n", c->fd);
+            return -1;
+        }
+        memmove(c->in, c->in + used, c->in_len - (size_t)used);
+        c->in_len -= (size_t)used;
+    }
+    return 0;
+}
+
+// Envía lo pendiente hasta que el socket no acepte más. Devuelve -1 si se cerró.
+static int conn_flush(Connection *c) {
+    while (conn_pending(c) > 0) {
+        ssize_t n = send(c->fd, c->out + c->out_off, conn_pending(c), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        c->out_off += (size_t)n;
+    }
+    return 0;
+}
+
+// Lee lo disponible en el socket. Devuelve -1 si el cliente cerró o hubo un error.
+static int conn_read(Connection *c) {
+    while (c->in_len < sizeof(c->in)) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        c->in_len += (size_t)n;
+    }
+    return 0;
+}
+
+static void conn_free(Connection *c) {
+    while (c->requests) request_end(c->requests);
+    c->next_closed = closed_conns;
+    closed_conns = c;
+}
+
+static void conn_reap(void) {
+    while (closed_conns) {
+        Connection *c = closed_conns;
+        closed_conns = c->next_closed;
+        free(c->out);
+        free(c);
+    }
+}
+
+// Cierra el socket. Las búsquedas que tiene el pool se sueltan cuando devuelva su
+// trabajo, y la conexión con la última.
+static void conn_close(Connection *c) {
+    printf("❌ Cliente con FD %d desconectado.\n", c->fd);
+    song_cache_report();
+    close(c->fd); // También lo saca de epoll
+    c->closed = 1;
+    for (Request *r = c->requests, *next; r; r = next) {
+        next = r->next_active;
+        if (r->job == JOB_NONE) request_end(r);
+        else if (parked_remove(r)) c->jobs--, request_end(r);
+    }
+    if (c->jobs == 0) conn_free(c);
+}
+
+// Se lee mientras haya espacio en la entrada y se espera EPOLLOUT solo con salida pendiente
+static int conn_update_events(int epfd, Connection *c) {
+    uint32_t events = (c->in_len < sizeof(c->in) ? EPOLLIN : 0) | (conn_pending(c) > 0 ? EPOLLOUT : 0);
+    if (events == c->events) return 0;
+    struct epoll_event ev = { .events = events, .data.ptr = c };
+    c->events = events;
+    return epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+// Atiende lo que se pueda sin bloquear y deja registrados los eventos que faltan
+static void conn_run(int epfd, Connection *c, int closed) {
+    // Lo ya recibido se atiende aunque el cliente haya cerrado su lado
+    do {
+        if (conn_process(c) != 0) closed = 1;
+        if (conn_flush(c) != 0) closed = 1;
+    } while (!closed && conn_pending(c) == 0 && conn_has_work(c));
+
+    if (closed || conn_update_events(epfd, c) != 0) conn_close(c);
+}
+
+static void conn_on_event(int epfd, Connection *c, uint32_t events) {
+    if (c->closed) return; // Evento de una conexión que se cerró en esta misma tanda
+    int closed = 0;
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) closed = conn_read(c) != 0;
+    conn_run(epfd, c, closed);
+}
+
+// Anota la conexión para enviarle lo encolado en conn_run_ready
+static void conn_mark_ready(Connection *c) {
+    if (c->ready) return;
+    c->ready = 1;
+    c->next_ready = ready_conns;
+    ready_conns = c;
+}
+
+static void conn_run_ready(int epfd) {
+    while (ready_conns) {
+        Connection *c = ready_conns;
+        ready_conns = c->next_ready;
+        c->ready = 0;
+        if (!c->closed) conn_run(epfd, c, 0);
+    }
+}
+
+// Aplica en el reactor el resultado de un trabajo terminado por el pool. La respuesta
+// queda encolada; la envía conn_run_ready junto con las demás de la tanda.
+static void request_job_done(Request *r) {
+    Connection *c = r->conn;
+    JobKind kind = r->job;
+    r->job = JOB_NONE;
+    c->jobs--;
+    if (c->closed) {
+        request_end(r);
+        if (c->jobs == 0) conn_free(c);
+        return;
+    }
+
+    if (kind == JOB_LOOKUP) {
+        if (r->expired) {
+            printf("[Cliente %d] ⏳ La búsqueda venció en la cola: servidor ocupado\n", c->fd);
+            request_busy(r);
+        } else {
+            uint8_t options = r->query.options;
+            request_send_count(r, r->found);
+            if (options & PROTO_SEARCH_COUNT_ONLY) request_end(r);
+            else if (options & PROTO_SEARCH_SONGS) request_confirm(r, 1); // Siempre termina con el fin
+            else if (r->found > 0) r->state = REQ_WAIT_CONFIRM;
+            else request_end(r);
+        }
+    } else {
+        for (int i = 0; i < r->batch_count; i++) request_send_song(r, &r->batch[i]);
+        r->batch_count = 0;
+        if (r->next >= r->page_end) request_page_done(r);
+    }
+    conn_mark_ready(c);
+}
+
+static void pool_drain_done(int epfd) {
+    uint64_t count;
+    while (read(work_pool.eventfd, &count, sizeof(count)) > 0) {}
+
+    pthread_mutex_lock(&work_pool.lock);
+    Request *done = work_pool.done;
+    work_pool.done = NULL;
+    pthread_mutex_unlock(&work_pool.lock);
+
+    while (done) {
+        Request *next = done->next_parked;
+        request_job_done(done);
+        done = next;
+    }
+    conn_run_ready(epfd);
+}
+
+// Pasa a la cola los trabajos que esperaban lugar; las búsquedas vencidas se
+// responden como ocupado. Devuelve los ms hasta el próximo plazo (-1 = ninguno).
+static int parked_retry(int epfd) {
+    while (parked_head) {
+        // Se desencola antes de entregarla: el pool reusa next_parked al terminar
+        Request *r = parked_head;
+        parked_head = r->next_parked;
+        if (!parked_head) parked_tail = NULL;
+
+        if (r->may_busy && deadline_passed(&r->deadline)) {
+            r->expired = 1;
+            request_job_done(r);
+        } else if (pool_try_submit(r) != 0) {
+            r->next_parked = parked_head;
+            parked_head = r;
+            if (!parked_tail) parked_tail = r;
+            break;
         }
     }
+    conn_run_ready(epfd);
+    if (!parked_head) return -1;
+
+    // La cabeza es la más antigua; si no tiene plazo (envío o búsqueda v1) se reintenta pronto
+    if (!parked_head->may_busy) return 1;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ms = (parked_head->deadline.tv_sec - now.tv_sec) * 1000 +
+              (parked_head->deadline.tv_nsec - now.tv_nsec) / 1000000 + 1;
+    return ms < 1 ? 1 : (ms > PARKED_POLL_MS ? PARKED_POLL_MS : (int)ms);
+}
+
+static void accept_clients(int epfd, int serverfd) {
+    while (1) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int clientfd = accept(serverfd, (struct sockaddr *)&client_addr, &client_len);
+        if (clientfd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("❌ Error al aceptar conexión");
+            return;
+        }
 
-    printf("❌ Cliente con FD %d desconectado. Cerrando hilo.\n", clientfd);
-    close(clientfd);
-    free(client_data); // Liberar la memoria que asignamos para los argumentos
-    pthread_exit(NULL);
+        Connection *c = calloc(1, sizeof(Connection));
+        struct epoll_event ev = { .events = EPOLLIN };
+        if (!c || fcntl(clientfd, F_SETFL, fcntl(clientfd, F_GETFL) | O_NONBLOCK) != 0 ||
+            (ev.data.ptr = c, epoll_ctl(epfd, EPOLL_CTL_ADD, clientfd, &ev)) != 0) {
+            perror("❌ No se pudo registrar la conexión");
+            free(c);
+            close(clientfd);
+            continue;
+        }
+        // Cada respuesta se arma completa en `out` antes del send: Nagle solo agregaría
+        // la espera del ACK retrasado del cliente en cada ida y vuelta
+        int nodelay = 1;
+        setsockopt(clientfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        c->fd = clientfd;
+        c->events = EPOLLIN;
+        printf("✅ Conexión aceptada de %s:%d (FD %d)\n", inet_ntoa(client_addr.sin_addr),
+               ntohs(client_addr.sin_port), clientfd);
+    }
 }
 
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Uso: %s <archivo_csv>\n", argv[0]);
+    const char *csv_path = NULL;
+    const char *preload_spec = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--preload") == 0) preload_spec = "all";
+        else if (strncmp(argv[i], "--preload=", 10) == 0) preload_spec = argv[i] + 10;
+        else if (!csv_path) csv_path = argv[i];
+        else csv_path = NULL, i = argc; // Argumento de más
+    }
+    if (!csv_path) {
+        fprintf(stderr, "Uso: %s <archivo_csv> [--preload[=all|top:N|emo1,emo2,...]]\n", argv[0]);
         return 1;
     }
-    const char *csv_path = argv[1];
+
+    if (map_csv(csv_path, &songs_csv) != 0) {
+        perror("❌ Error abriendo CSV");
+        exit(EXIT_FAILURE);
+    }
+    // Las canciones se leen salteadas: sin lectura anticipada de páginas vecinas
+    if (songs_csv.data) posix_madvise((void *)songs_csv.data, songs_csv.size, POSIX_MADV_RANDOM);
 
     int serverfd;
     struct sockaddr_in server_addr;
@@ -309,6 +1243,37 @@ int main(int argc, char *argv[]) {
     const char *port_str = getenv("PORT");
     int port = port_str ? atoi(port_str) : 3550;
 
+    char dict_path[PATH_MAX];
+    snprintf(dict_path, sizeof(dict_path), "%s%s", index_folder, ARTIST_DICT_FILE);
+    if (map_artist_dictionary(&artist_dictionary, dict_path) != 0) {
+        fprintf(stderr, "❌ No se pudo cargar el diccionario de artistas. ¿Se ejecutó el indexador?\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("📖 Diccionario de artistas cargado: %u artistas\n", artist_dictionary.header->artist_count);
+    HashProbeStats dict_stats;
+    artist_dictionary_probe_stats(&artist_dictionary, &dict_stats);
+    hash_probe_report("Diccionario de artistas", &dict_stats,
+                      artist_dictionary.header->artist_count, artist_dictionary.header->hash_slots);
+
+    IndexManifest manifest;
+    if (read_index_manifest(&manifest) == 0) {
+        index_segments = manifest.segment_count;
+        printf("📚 Índice de %llu canciones en %u segmentos delta\n", (unsigned long long)manifest.rows, index_segments);
+    }
+
+    // Presupuesto en MB para la caché de índices mapeados
+    const char *cache_mb_str = getenv("INDEX_CACHE_MB");
+    if (cache_mb_str && atol(cache_mb_str) > 0)
+        index_cache.budget = (size_t)atol(cache_mb_str) << 20;
+
+    // Presupuesto en MB para la caché de canciones parseadas (0 la desactiva)
+    const char *song_cache_str = getenv("SONG_CACHE_MB");
+    long song_cache_mb = song_cache_str && atol(song_cache_str) >= 0 ? atol(song_cache_str) : DEFAULT_SONG_CACHE_MB;
+    song_cache_init(&song_cache, (size_t)song_cache_mb << 20);
+
+    // La precarga termina antes de listen(): no se aceptan clientes hasta que esté lista
+    if (preload_spec) preloadIndexes(preload_spec);
+
     serverfd = socket(AF_INET, SOCK_STREAM, 0);
     if (serverfd == -1) {
         perror("❌ Error creando socket del servidor");
@@ -330,43 +1295,47 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    printf("🚀 Servidor multihilo escuchando en el puerto %d...\n", port);
-
-    // MODIFICADO: Bucle principal ahora solo acepta conexiones y crea hilos
-    while (1) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        int clientfd = accept(serverfd, (struct sockaddr *)&client_addr, &client_len);
+    if (pool_start() != 0) {
+        perror("❌ Error iniciando el pool de trabajo");
+        exit(EXIT_FAILURE);
+    }
 
-        if (clientfd < 0) {
-            perror("❌ Error al aceptar conexión");
-            continue; // Seguir intentando
-        }
+    int epfd = epoll_create1(0);
+    struct epoll_event listen_ev = { .events = EPOLLIN, .data.ptr = NULL };
+    struct epoll_event pool_ev = { .events = EPOLLIN, .data.ptr = &work_pool };
+    if (epfd == -1 || fcntl(serverfd, F_SETFL, fcntl(serverfd, F_GETFL) | O_NONBLOCK) != 0 ||
+        epoll_ctl(epfd, EPOLL_CTL_ADD, serverfd, &listen_ev) != 0 ||
+        epoll_ctl(epfd, EPOLL_CTL_ADD, work_pool.eventfd, &pool_ev) != 0) {
+        perror("❌ Error creando el reactor epoll");
+        exit(EXIT_FAILURE);
+    }
 
-        printf("✅ Conexión aceptada de %s:%d\n", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+    printf("🚀 Servidor (epoll) escuchando en el puerto %d (caché de índices: %zu MB, de canciones: %zu MB)...\n",
+           port, index_cache.budget >> 20, song_cache.budget >> 20);
 
-        // Preparar argumentos para el nuevo hilo
-        client_args_t *args = malloc(sizeof(client_args_t));
-        if (!args) {
-            perror("malloc failed");
-            close(clientfd);
-            continue;
+    // Bucle de eventos: el socket de escucha se registra con data.ptr = NULL y el
+    // eventfd del pool con &work_pool. Mientras haya trabajos esperando lugar en la
+    // cola, epoll_wait vuelve a tiempo para reintentarlos o vencerlos. Las conexiones
+    // cerradas en la tanda se liberan al final, cuando ya no quedan eventos suyos.
+    struct epoll_event events[MAX_EVENTS];
+    int timeout = -1;
+    while (1) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("❌ Error en epoll_wait");
+            break;
         }
-        args->client_socket = clientfd;
-        strncpy(args->csv_path, csv_path, sizeof(args->csv_path) - 1);
-        
-        // Crear el hilo para manejar al cliente
-        pthread_t thread_id;
-        if (pthread_create(&thread_id, NULL, handle_client, (void *)args) != 0) {
-            perror("❌ No se pudo crear el hilo");
-            free(args);
-            close(clientfd);
+        for (int i = 0; i < n; i++) {
+            if (!events[i].data.ptr) accept_clients(epfd, serverfd);
+            else if (events[i].data.ptr == &work_pool) pool_drain_done(epfd);
+            else conn_on_event(epfd, events[i].data.ptr, events[i].events);
         }
-
-        // Desvincular el hilo para que sus recursos se liberen automáticamente al terminar
-        pthread_detach(thread_id);
+        timeout = parked_retry(epfd);
+        conn_reap();
     }
 
+    close(epfd);
     close(serverfd);
     return 0;
 }
\ No newline at end of file
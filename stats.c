@@ -0,0 +1,351 @@
+// stats.c (Estadísticas del dataset: una sola pasada paralela por el CSV, o desde los índices .bin)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "./helpers/indexador.h"
+
+#define STATS_BUCKETS 101        // Histogramas por valor entero (0 a 100)
+#define DEFAULT_TOP_ARTISTS 20
+
+// Conteo por nombre: los nombres se internan en un diccionario (mismo hash que los
+// artistas del índice) y `counts` se indexa por su id
+typedef struct {
+    ArtistDictBuilder names;
+    uint64_t *counts;
+    uint32_t capacity;
+} CountTable;
+
+// Resultados de un hilo sobre su rango de líneas; al final se suman todos
+typedef struct {
+    const char *data;
+    uint64_t begin, end;
+    long rows;
+    uint64_t arousal[STATS_BUCKETS];
+    uint64_t valence[STATS_BUCKETS];
+    uint64_t dominance[STATS_BUCKETS];
+    CountTable emotions, genres, artists;
+} StatsPartial;
+
+// Nombre y total de una fila de un reporte ordenado
+typedef struct {
+    const char *name;
+    uint64_t count;
+} NamedCount;
+
+static int count_table_add(CountTable *table, const char *name, uint64_t n) {
+    uint32_t id = artist_dict_intern(&table->names, name);
+    if (id == ARTIST_ID_NONE) return -1;
+    if (id >= table->capacity) {
+        uint32_t capacity = table->capacity ? table->capacity * 2 : 64;
+        while (capacity <= id) capacity *= 2;
+        uint64_t *grown = realloc(table->counts, sizeof(uint64_t) * capacity);
+        if (!grown) {
+            perror("realloc");
+            return -1;
+        }
+        memset(grown + table->capacity, 0, sizeof(uint64_t) * (capacity - table->capacity));
+        table->counts = grown;
+        table->capacity = capacity;
+    }
+    table->counts[id] += n;
+    return 0;
+}
+
+static void count_table_merge(CountTable *dst, const CountTable *src) {
+    for (uint32_t id = 0; id < src->names.count; id++)
+        count_table_add(dst, src->names.names[id], src->counts[id]);
+}
+
+static void count_table_free(CountTable *table) {
+    artist_dict_reset(&table->names);
+    free(table->counts);
+    memset(table, 0, sizeof(*table));
+}
+
+static void histogram_add(uint64_t *histogram, double value) {
+    int bucket = (int)value;
+    if (bucket >= 0 && bucket < STATS_BUCKETS) histogram[bucket]++;
+}
+
+// Una fila del CSV: mismas columnas y misma lectura de seeds que el indexador
+static void stats_line(StatsPartial *partial, const char *line, const char *end) {
+    CsvSpan tokens[NUM_FIELDS];
+    if (csv_split_fields(line, end, tokens, NUM_FIELDS) <= 7) return;
+    partial->rows++;
+
+    histogram_add(partial->valence, csv_span_atof(&tokens[5]));
+    histogram_add(partial->arousal, csv_span_atof(&tokens[6]));
+    histogram_add(partial->dominance, csv_span_atof(&tokens[7]));
+
+    char name[MAX_FIELD];
+    csv_span_copy(name, sizeof(name), &tokens[2]);
+    count_table_add(&partial->artists, name, 1);
+    csv_span_copy(name, sizeof(name), &tokens[11]);
+    count_table_add(&partial->genres, name, 1);
+
+    const char *q = tokens[3].start;
+    const char *seeds_end = tokens[3].start + (tokens[3].len < MAX_FIELD - 1 ? tokens[3].len : MAX_FIELD - 1);
+    while ((q = memchr(q, '\'', seeds_end - q)) != NULL) {
+        q++;
+        const char *close = memchr(q, '\'', seeds_end - q);
+        if (!close) break;
+
+        CsvSpan seed = { q, (size_t)(close - q) };
+        csv_span_copy(name, sizeof(name), &seed);
+        sanitize_input(name);
+        if (name[0]) count_table_add(&partial->emotions, name, 1);
+        q = close + 1;
+    }
+}
+
+static void *stats_worker(void *arg) {
+    StatsPartial *partial = arg;
+    const char *p = partial->data + partial->begin, *end = partial->data + partial->end;
+    while (p < end) {
+        const char *newline = memchr(p, '\n', end - p);
+        const char *line_end = newline ? newline : end;
+        const char *content_end = line_end;
+        if (content_end > p && content_end[-1] == '\r') content_end--;
+        if (content_end > p) stats_line(partial, p, content_end);
+        p = line_end + 1;
+    }
+    return NULL;
+}
+
+// Inicio de la línea que contiene `pos` o la siguiente (o `size`)
+static uint64_t line_start_after(const char *data, uint64_t size, uint64_t pos) {
+    if (pos == 0 || pos >= size) return pos < size ? pos : size;
+    if (data[pos - 1] == '\n') return pos;
+    const char *newline = memchr(data + pos, '\n', size - pos);
+    return newline ? (uint64_t)(newline - data) + 1 : size;
+}
+
+static int compare_named_counts(const void *a, const void *b) {
+    const NamedCount *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+// Imprime los `limit` nombres más frecuentes (0 = todos)
+static void print_count_table(const char *title, const CountTable *table, uint32_t limit) {
+    NamedCount *rows = malloc(sizeof(NamedCount) * (table->names.count ? table->names.count : 1));
+    if (!rows) {
+        perror("malloc");
+        return;
+    }
+    for (uint32_t id = 0; id < table->names.count; id++)
+        rows[id] = (NamedCount){ table->names.names[id], table->counts[id] };
+    qsort(rows, table->names.count, sizeof(NamedCount), compare_named_counts);
+
+    uint32_t shown = limit && limit < table->names.count ? limit : table->names.count;
+    printf("\n%s (%u distintos):\n", title, table->names.count);
+    for (uint32_t i = 0; i < shown; i++)
+        printf("  %-32s %llu\n", rows[i].name[0] ? rows[i].name : "(vacío)", (unsigned long long)rows[i].count);
+    free(rows);
+}
+
+static void print_histogram(const char *title, const uint64_t *histogram) {
+    printf("\n%s:\n", title);
+    for (int i = 0; i < STATS_BUCKETS; i++)
+        if (histogram[i] > 0) printf("  %3d: %llu\n", i, (unsigned long long)histogram[i]);
+}
+
+static double seconds_since(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - since->tv_sec) + (now.tv_nsec - since->tv_nsec) / 1e9;
+}
+
+// Una pasada por el CSV mapeado, repartida en index_threads rangos alineados a líneas
+static int stats_from_csv(const char *csv_path, uint32_t top_artists) {
+    int fd = open(csv_path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror("❌ No se pudo abrir el CSV");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    uint64_t size = (uint64_t)st.st_size;
+    const char *data = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (size && data == MAP_FAILED) {
+        perror("❌ No se pudo mapear el CSV");
+        return -1;
+    }
+    if (size) posix_madvise((void *)data, size, POSIX_MADV_SEQUENTIAL);
+
+    struct timespec began;
+    clock_gettime(CLOCK_MONOTONIC, &began);
+
+    // Saltar encabezado
+    const char *header_end = size ? memchr(data, '\n', size) : NULL;
+    uint64_t start = header_end ? (uint64_t)(header_end - data) + 1 : size;
+
+    StatsPartial *partials = calloc(index_threads, sizeof(StatsPartial));
+    pthread_t threads[MAX_INDEX_THREADS];
+    if (!partials) {
+        perror("calloc");
+        if (size) munmap((void *)data, size);
+        return -1;
+    }
+    uint64_t begin = start;
+    for (int i = 0; i < index_threads; i++) {
+        partials[i].data = data;
+        partials[i].begin = begin;
+        partials[i].end = i == index_threads - 1 ? size
+                        : line_start_after(data, size, start + (size - start) / index_threads * (i + 1));
+        if (partials[i].end < begin) partials[i].end = begin;
+        begin = partials[i].end;
+    }
+
+    int started[MAX_INDEX_THREADS];
+    for (int i = 0; i < index_threads; i++) {
+        started[i] = pthread_create(&threads[i], NULL, stats_worker, &partials[i]) == 0;
+        if (!started[i]) stats_worker(&partials[i]);
+    }
+    for (int i = 0; i < index_threads; i++)
+        if (started[i]) pthread_join(threads[i], NULL);
+
+    StatsPartial total = {0};
+    for (int i = 0; i < index_threads; i++) {
+        total.rows += partials[i].rows;
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            total.arousal[b] += partials[i].arousal[b];
+            total.valence[b] += partials[i].valence[b];
+            total.dominance[b] += partials[i].dominance[b];
+        }
+        count_table_merge(&total.emotions, &partials[i].emotions);
+        count_table_merge(&total.genres, &partials[i].genres);
+        count_table_merge(&total.artists, &partials[i].artists);
+        count_table_free(&partials[i].emotions);
+        count_table_free(&partials[i].genres);
+        count_table_free(&partials[i].artists);
+    }
+    free(partials);
+    double secs = seconds_since(&began);
+    if (size) munmap((void *)data, size);
+
+    printf("📊 %ld canciones en %.1f MB (%.2f s, %.1f MB/s, %d hilos)\n", total.rows, size / 1048576.0, secs,
+           secs > 0 ? size / 1048576.0 / secs : 0.0, index_threads);
+    print_histogram("🎚️  Canciones por valor entero de arousal", total.arousal);
+    print_histogram("🙂 Canciones por valor entero de valence", total.valence);
+    print_histogram("💪 Canciones por valor entero de dominance", total.dominance);
+    print_count_table("🎭 Apariciones por emoción", &total.emotions, 0);
+    print_count_table("🎸 Canciones por género", &total.genres, 0);
+    print_count_table("🎤 Artistas con más canciones", &total.artists, top_artists);
+
+    count_table_free(&total.emotions);
+    count_table_free(&total.genres);
+    count_table_free(&total.artists);
+    return 0;
+}
+
+// Conteos por emoción y arousal leyendo solo las tablas de artistas de los índices
+// (base y segmentos delta); no decodifica listas ni abre el CSV
+static int stats_from_index(void) {
+    IndexManifest manifest;
+    int has_manifest = read_index_manifest(&manifest) == 0;
+    uint32_t segments = has_manifest ? manifest.segment_count : 0;
+
+    DIR *dir = opendir(index_folder);
+    if (!dir) {
+        perror("❌ No se pudo abrir la carpeta de índices");
+        return -1;
+    }
+
+    CountTable emotions = {0};
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        char emotion[MAX_FIELD];
+        uint32_t segment;
+        if (parse_index_file_name(de->d_name, emotion, &segment) == 0 && segment <= segments)
+            count_table_add(&emotions, emotion, 0);
+    }
+    closedir(dir);
+
+    uint64_t arousal[STATS_BUCKETS] = {0};
+    uint64_t total = 0, artists = 0, bytes = 0;
+    for (uint32_t id = 0; id < emotions.names.count; id++) {
+        EmotionIndex *eidx = calloc(1, sizeof(EmotionIndex));
+        if (!eidx || map_emotion_segments(eidx, emotions.names.names[id], segments) != 0) {
+            free_emotion_index(eidx);
+            continue;
+        }
+        for (const EmotionIndex *seg = eidx; seg; seg = seg->next_segment) {
+            for (int a = 0; a < AROUSAL_LEVELS && a < STATS_BUCKETS; a++) {
+                const IndexArousalEntry *level = &seg->arousal_dir[a];
+                for (uint32_t j = 0; j < level->artist_count; j++)
+                    arousal[a] += seg->artist_table[level->first_artist + j].position_count;
+            }
+            emotions.counts[id] += seg->header->position_count;
+            artists += seg->header->artist_count;
+        }
+        bytes += emotion_index_size(eidx);
+        total += emotions.counts[id];
+        free_emotion_index(eidx);
+    }
+
+    if (has_manifest)
+        printf("📚 Índice de %llu canciones (%.1f MB de CSV) en %u segmentos delta\n",
+               (unsigned long long)manifest.rows, manifest.indexed_bytes / 1048576.0, segments);
+    printf("📊 %llu posiciones y %llu entradas de artista en %.1f MB de índices\n", (unsigned long long)total,
+           (unsigned long long)artists, bytes / 1048576.0);
+    print_histogram("🎚️  Apariciones por valor entero de arousal", arousal);
+    print_count_table("🎭 Apariciones por emoción", &emotions, 0);
+    count_table_free(&emotions);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Uso: %s <archivo_csv> [--threads=N] [--top=N]\n"
+            "     %s --from-index [--output=DIR]\n"
+            "  --threads=N      Hilos de la pasada por el CSV (1..%d, por defecto %d)\n"
+            "  --top=N          Artistas a mostrar (por defecto %d)\n"
+            "  --from-index     Emociones y arousal desde los .bin, sin leer el CSV\n"
+            "  --output=DIR     Carpeta de los índices (por defecto %s)\n",
+            prog, prog, MAX_INDEX_THREADS, NUM_THREADS, DEFAULT_TOP_ARTISTS, INDEX_FOLDER);
+}
+
+int main(int argc, char *argv[]) {
+    const char *csv_path = NULL;
+    int from_index = 0;
+    long top_artists = DEFAULT_TOP_ARTISTS;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        char *end = NULL;
+        if (strncmp(arg, "--threads=", 10) == 0) {
+            long value = strtol(arg + 10, &end, 10);
+            if (*end != '\0' || value < 1 || value > MAX_INDEX_THREADS) goto bad_option;
+            index_threads = (int)value;
+        } else if (strncmp(arg, "--top=", 6) == 0) {
+            top_artists = strtol(arg + 6, &end, 10);
+            if (*end != '\0' || top_artists < 0 || top_artists > UINT32_MAX) goto bad_option;
+        } else if (strncmp(arg, "--output=", 9) == 0) {
+            if (set_index_folder(arg + 9) != 0) goto bad_option;
+        } else if (strcmp(arg, "--from-index") == 0) {
+            from_index = 1;
+        } else if (strncmp(arg, "--", 2) != 0 && !csv_path) {
+            csv_path = arg;
+        } else {
+bad_option:
+            fprintf(stderr, "❌ Opción inválida: %s\n", arg);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (from_index) return stats_from_index() == 0 ? 0 : 1;
+    if (!csv_path) {
+        usage(argv[0]);
+        return 1;
+    }
+    return stats_from_csv(csv_path, (uint32_t)top_artists) == 0 ? 0 : 1;
+}